@@ -0,0 +1,173 @@
+/*
+ * \brief   Find ACPI tables.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+
+#include "util.h"
+#include "acpi.h"
+
+
+/**
+ * Sum up all bytes. Valid ACPI structures sum up to zero.
+ */
+unsigned char
+acpi_checksum(const void *data, unsigned len)
+{
+  unsigned char res = 0;
+  for (const unsigned char *p = data; len--; p++)
+    res += *p;
+  return res;
+}
+
+
+/**
+ * Compare a signature.
+ */
+static
+int
+acpi_match(const char *a, const char *b, unsigned len)
+{
+  while (len--)
+    if (*a++ != *b++)
+      return 0;
+  return 1;
+}
+
+
+/**
+ * Search the RSDP in a memory range.
+ */
+static
+struct acpi_rsdp *
+acpi_search_rsdp(unsigned start, unsigned end)
+{
+  for (; start < end; start += 16)
+    {
+      struct acpi_rsdp *rsdp = (struct acpi_rsdp *) start;
+      if (acpi_match(rsdp->signature, "RSD PTR ", 8) && !acpi_checksum(rsdp, 20))
+	return rsdp;
+    }
+  return 0;
+}
+
+
+/**
+ * Returns the EBDA address from the BIOS data area.  Read via asm, as
+ * the compiler treats a pointer into the first page like a null
+ * pointer.
+ */
+static inline
+unsigned
+acpi_ebda(void)
+{
+  unsigned short res;
+  asm volatile ("movw 0x40e, %0" : "=r"(res));
+  return res << 4;
+}
+
+
+/**
+ * Find the RSDP in the first KB of the EBDA or in the BIOS area.
+ */
+struct acpi_rsdp *
+acpi_find_rsdp(void)
+{
+  unsigned ebda = acpi_ebda();
+  struct acpi_rsdp *res = 0;
+  if (ebda)
+    res = acpi_search_rsdp(ebda, ebda + 1024);
+  if (!res)
+    res = acpi_search_rsdp(0xe0000, 0x100000);
+  return res;
+}
+
+
+/**
+ * Find an ACPI table by its signature via the XSDT or RSDT.
+ * Returns 0 if not found.
+ */
+struct acpi_table *
+acpi_find_table(const char *signature)
+{
+  struct acpi_rsdp *rsdp = acpi_find_rsdp();
+  CHECK3(0, !rsdp, "no RSDP");
+
+  // use the XSDT only if it is reachable
+  unsigned xsdt = rsdp->revision >= 2 && !(rsdp->xsdt >> 32) && rsdp->xsdt;
+  struct acpi_table *sdt = (struct acpi_table *) (xsdt ? (unsigned) rsdp->xsdt : rsdp->rsdt);
+  CHECK3(0, !sdt || acpi_checksum(sdt, sdt->length), "invalid RSDT");
+
+  unsigned size = xsdt ? 8 : 4;
+  for (unsigned i = sizeof(*sdt); i + size <= sdt->length; i += size)
+    {
+      unsigned *entry = (unsigned *) ((char *) sdt + i);
+      if (xsdt && entry[1])
+	continue;
+      struct acpi_table *table = (struct acpi_table *) entry[0];
+      if (table && acpi_match(table->signature, signature, 4) && !acpi_checksum(table, table->length))
+	return table;
+    }
+  return 0;
+}
+
+
+/**
+ * Recalculate the checksum of a table after it was modified.
+ */
+void
+acpi_fix_checksum(struct acpi_table *table)
+{
+  table->checksum = 0;
+  table->checksum = -acpi_checksum(table, table->length);
+}
+
+
+/**
+ * Replace the entries pointing to a table in a RSDT or XSDT.
+ */
+static
+unsigned
+acpi_replace_entries(struct acpi_table *sdt, unsigned size, struct acpi_table *old, struct acpi_table *new)
+{
+  unsigned res = 0;
+  if (!sdt || acpi_checksum(sdt, sdt->length))
+    return 0;
+  for (unsigned i = sizeof(*sdt); i + size <= sdt->length; i += size)
+    {
+      unsigned *entry = (unsigned *) ((char *) sdt + i);
+      if (entry[0] == (unsigned) old && (size == 4 || !entry[1]))
+	{
+	  entry[0] = (unsigned) new;
+	  res++;
+	}
+    }
+  if (res)
+    acpi_fix_checksum(sdt);
+  return res;
+}
+
+
+/**
+ * Let the RSDT and the XSDT point to a new copy of a table.
+ */
+int
+acpi_replace_table(struct acpi_table *old, struct acpi_table *new)
+{
+  struct acpi_rsdp *rsdp = acpi_find_rsdp();
+  CHECK3(-1, !rsdp, "no RSDP");
+
+  unsigned res = acpi_replace_entries((struct acpi_table *) rsdp->rsdt, 4, old, new);
+  if (rsdp->revision >= 2 && !(rsdp->xsdt >> 32))
+    res += acpi_replace_entries((struct acpi_table *) (unsigned) rsdp->xsdt, 8, old, new);
+  CHECK3(-2, !res, "table not referenced");
+  return 0;
+}
@@ -15,10 +15,16 @@
 #include "version.h"
 #include "util.h"
 #include "sha.h"
+#include "sha256.h"
 #include "tpm.h"
+#include "tpm2.h"
 #include "elf.h"
+#include "stage.h"
+#include "trace.h"
 
+#ifndef STAGED
 const char *message_label = "BEIRUT: ";
+#endif
 
 
 /**
@@ -27,8 +33,10 @@ const char *message_label = "BEIRUT: ";
  */
 static
 int
-mbi_hash_cmd_line(struct mbi *mbi, struct Context *ctx)
+mbi_hash_cmd_line(struct mbi *mbi, unsigned char *buffer, struct Context *ctx)
 {
+  struct Sha256Context ctx256;
+  unsigned sha256_bank = tpm2_banks & TPM2_BANK_SHA256;
   unsigned res;
 
   ERROR(-11, ~mbi->flags & MBI_FLAG_MODS, "module flag missing");
@@ -36,17 +44,42 @@ mbi_hash_cmd_line(struct mbi *mbi, struct Context *ctx)
   out_description("number of modules:", mbi->mods_count);
 
   sha1_init(ctx);
+  sha256_init(&ctx256);
 
   struct module *m  = (struct module *) (mbi->mods_addr);
   for (unsigned i=0; i < mbi->mods_count; i++, m++)
-    sha1(ctx, (unsigned char*) m->string, strlen((char*) m->string) + 1);
+    {
+      sha1(ctx, (unsigned char*) m->string, strlen((char*) m->string) + 1);
+      if (sha256_bank)
+	sha256(&ctx256, (unsigned char*) m->string, strlen((char*) m->string) + 1);
+    }
 
   sha1_finish(ctx);
-  CHECK4(-13, (res = TPM_Extend(ctx->buffer, 19, ctx->hash)), "TPM extend failed", res);
+  if (sha256_bank)
+    sha256_finish(&ctx256);
+  CHECK4(-13, (res = tpm_extend(buffer, 19, ctx->hash, ctx256.hash)), "TPM extend failed", res);
   return 0;
 }
 
 
+/**
+ * The beirut stage. Expects that the TPM was already accessed in
+ * locality 2.
+ */
+int
+beirut(struct mbi *mbi)
+{
+  struct Context ctx;
+  unsigned char buffer[TPM2_BUFFER_SIZE];
+  trace("beirut");
+  // the command line stays unmeasured like the modules in OSLO
+  if (0 > tpm2_detect(buffer))
+    return 0;
+  return mbi_hash_cmd_line(mbi, buffer, &ctx);
+}
+
+
+#ifndef STAGED
 /**
  * Hash the command line of all following mbi modules and start the
  * next one.
@@ -54,17 +87,16 @@ mbi_hash_cmd_line(struct mbi *mbi, struct Context *ctx)
 int
 __main(struct mbi *mbi, unsigned flags)
 {
-  struct Context ctx;
-
 #ifndef NDEBUG
   serial_init();
 #endif
+  trace("main");
   out_info(VERSION " hashes command lines");
   ERROR(10, !mbi || flags != MBI_MAGIC, "Not loaded via multiboot");
 
   if (tis_init(TIS_BASE) && tis_access(TIS_LOCALITY_2, 0))
     {
-      if (!mbi_hash_cmd_line(mbi, &ctx))
+      if (!beirut(mbi))
 	ERROR(12, tis_deactivate_all(), "tis_deactivate failed");
     }
 
@@ -72,3 +104,4 @@ __main(struct mbi *mbi, unsigned flags)
   ERROR(13, start_module(mbi), "start module failed");
   return 14;
 }
+#endif
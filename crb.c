@@ -0,0 +1,120 @@
+/*
+ * \brief   CRB access routines
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * The Command Response Buffer interface of TPM 2.0 devices, which is
+ * used by firmware TPMs.  A command is copied into a buffer and the
+ * response is read from a buffer, thus there is no handshake per
+ * byte as with the TIS FIFO.  tis.c dispatches to these functions if
+ * the interface id reports a CRB.
+ */
+
+#include "util.h"
+#include "asm.h"
+#include "tis.h"
+#include "crb.h"
+
+
+/**
+ * Wait until (*reg & mask) == value or the timeout in ms is over.
+ * Returns zero on success.
+ */
+static
+int
+crb_wait(volatile unsigned int *reg, unsigned mask, unsigned value, unsigned timeout)
+{
+  for (unsigned i=0; i < timeout; i++)
+    {
+      if ((*reg & mask) == value)
+	return 0;
+      wait(1);
+    }
+  return (*reg & mask) != value;
+}
+
+
+/**
+ * Request access for the locality at the given address.
+ * Returns 0 if we could not gain access.
+ */
+int
+crb_access(unsigned locality, int force)
+{
+  volatile struct crb_mmap *mmap = (struct crb_mmap *) locality;
+
+  CHECK3(0, !(mmap->loc_state & CRB_LOC_STATE_VALID), "locality state not valid");
+  mmap->loc_ctrl = force ? CRB_LOC_CTRL_SEIZE : CRB_LOC_CTRL_REQUEST;
+  return !crb_wait(&mmap->loc_sts, CRB_LOC_STS_GRANTED, CRB_LOC_STS_GRANTED, TIS_TIMEOUT_A);
+}
+
+
+/**
+ * Relinquish all localities.
+ * Returns zero if no locality is active.
+ */
+int
+crb_deactivate_all(unsigned base)
+{
+  volatile struct crb_mmap *mmap = (struct crb_mmap *) base;
+  for (unsigned i=0; i<5; i++)
+    ((volatile struct crb_mmap *)(base + (i<<12)))->loc_ctrl = CRB_LOC_CTRL_RELINQUISH;
+  return mmap->loc_state & CRB_LOC_STATE_ASSIGNED;
+}
+
+
+/**
+ * Copy a command into the command buffer and start it.
+ * Returns the number of bytes sent or a value < 0 on errors.
+ */
+int
+crb_transmit_start(unsigned locality, const unsigned char *write_buffer, unsigned write_count)
+{
+  volatile struct crb_mmap *mmap = (struct crb_mmap *) locality;
+
+  CHECK3(-1, mmap->cmd_haddr || mmap->rsp_haddr, "CRB buffer above 4G");
+  CHECK4(-2, write_count > mmap->cmd_size, "CRB command too large", write_count);
+
+  // make the tpm ready -> wakeup from idle state
+  mmap->ctrl_req = CRB_CTRL_REQ_READY;
+  CHECK3(-3, crb_wait(&mmap->ctrl_req, CRB_CTRL_REQ_READY, 0, TIS_TIMEOUT_C), "CRB not ready");
+  CHECK3(-4, mmap->ctrl_sts & CRB_CTRL_STS_ERROR, "CRB error");
+
+  memcpy((unsigned char *) mmap->cmd_laddr, write_buffer, write_count);
+  mmap->ctrl_start = CRB_CTRL_START;
+  return write_count;
+}
+
+
+/**
+ * Wait for the command to complete and copy the response out.
+ * Returns the number of bytes received or a value < 0 on errors.
+ */
+int
+crb_transmit_finish(unsigned locality, unsigned char *read_buffer, unsigned read_count)
+{
+  volatile struct crb_mmap *mmap = (struct crb_mmap *) locality;
+  unsigned size;
+
+  CHECK3(-5, crb_wait(&mmap->ctrl_start, CRB_CTRL_START, 0, TIS_TIMEOUT_B), "CRB command timeout");
+  CHECK3(-6, mmap->ctrl_sts & CRB_CTRL_STS_ERROR, "CRB error");
+
+  unsigned char *rsp = (unsigned char *) mmap->rsp_laddr;
+  size = ntohl(*(unsigned int *)(rsp + 2));
+  CHECK4(-7, size < CRB_RESPONSE_HEADER || size > mmap->rsp_size, "CRB invalid response size", size);
+  CHECK4(-8, size > read_count, "more data available", size);
+  memcpy(read_buffer, rsp, size);
+
+  // let the tpm go idle again -> this allows tpm background jobs to complete
+  mmap->ctrl_req = CRB_CTRL_REQ_IDLE;
+  return size;
+}
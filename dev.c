@@ -15,6 +15,90 @@
 
 #include "util.h"
 #include "dev.h"
+#include "acpi.h"
+#include "mbi.h"
+#include "elf.h"
+#include "mem.h"
+
+
+#ifdef CONFIG_PCI
+#ifdef CONFIG_ECAM
+/**
+ * The memory mapped config space found by pci_init_ecam().
+ */
+static unsigned pci_ecam_base;
+static unsigned char pci_ecam_start_bus;
+static unsigned char pci_ecam_end_bus;
+
+
+/**
+ * Return the ECAM address of a config space register or 0 if the bus
+ * is not covered by the memory mapped config space.  The AMD extended
+ * register bits 27:24 of the port address select the upper 4k.
+ */
+static
+volatile void *
+pci_ecam(unsigned addr)
+{
+  unsigned char bus = addr >> 16;
+  if (!pci_ecam_base || bus < pci_ecam_start_bus || bus > pci_ecam_end_bus)
+    return 0;
+  return (void *)(pci_ecam_base + ((addr & 0xffff00) << 4) + ((addr >> 16) & 0xf00) + (addr & 0xff));
+}
+
+
+/**
+ * Find the memory mapped config space of segment 0 in the MCFG table
+ * or in the MMIO_CFG_BASE MSR of AMD family 10h and later.  Regions
+ * above 4G are not reachable and we keep using the config ports.
+ */
+static
+void
+pci_init_ecam(void)
+{
+  struct acpi_mcfg *mcfg = (struct acpi_mcfg *) acpi_find_table("MCFG");
+  if (mcfg)
+    for (struct acpi_mcfg_entry *e = mcfg->entries; (char *)(e + 1) <= (char *)mcfg + mcfg->hdr.length; e++)
+      if (!e->segment && !(e->base >> 32) && e->base)
+	{
+	  pci_ecam_base = e->base;
+	  pci_ecam_start_bus = e->start_bus;
+	  pci_ecam_end_bus = e->end_bus;
+	  break;
+	}
+
+  if (!pci_ecam_base && cpuid_ebx(0) == 0x68747541 && (cpuid_eax(1) >> 20 & 0xff) >= 1)
+    {
+      unsigned long long value = rdmsr(MSR_MMIO_CFG_BASE);
+      if ((value & MMIO_CFG_ENABLE) && !(value >> 32))
+	{
+	  unsigned buses = 1 << (value >> MMIO_CFG_BUS_RANGE_SHIFT & 0xf);
+	  pci_ecam_base = value & MMIO_CFG_BASE_MASK;
+	  pci_ecam_start_bus = 0;
+	  pci_ecam_end_bus = buses > 256 ? 255 : buses - 1;
+	}
+    }
+#ifndef NDEBUG
+  if (pci_ecam_base)
+    out_description("ecam", pci_ecam_base);
+#endif
+}
+#else
+static inline
+volatile void *
+pci_ecam(unsigned addr)
+{
+  (void) addr;
+  return 0;
+}
+
+static inline
+void
+pci_init_ecam(void)
+{
+}
+#endif
+
 
 /**
  * Read a byte from the pci config space.
@@ -22,6 +106,9 @@
 unsigned char
 pci_read_byte(unsigned addr)
 {
+  volatile void *p = pci_ecam(addr);
+  if (p)
+    return mmio_config_readb(p);
   outl(PCI_ADDR_PORT, addr);
   return inb(PCI_DATA_PORT + (addr & 3));
 }
@@ -32,6 +119,9 @@ pci_read_byte(unsigned addr)
 unsigned short
 pci_read_word(unsigned addr)
 {
+  volatile void *p = pci_ecam(addr & ~1);
+  if (p)
+    return mmio_config_readw(p);
   outl(PCI_ADDR_PORT, addr);
   return inw(PCI_DATA_PORT + (addr & 2));
 }
@@ -43,6 +133,9 @@ pci_read_word(unsigned addr)
 unsigned
 pci_read_long(unsigned addr)
 {
+  volatile void *p = pci_ecam(addr & ~3);
+  if (p)
+    return mmio_config_readl(p);
   outl(PCI_ADDR_PORT, addr);
   return inl(PCI_DATA_PORT);
 }
@@ -54,8 +147,14 @@ pci_read_long(unsigned addr)
 void
 pci_write_word(unsigned addr, unsigned short value)
 {
-  outl(PCI_ADDR_PORT, addr);
-  outw(PCI_DATA_PORT + (addr & 2), value);
+  volatile void *p = pci_ecam(addr & ~1);
+  if (p)
+    mmio_config_writew(p, value);
+  else
+    {
+      outl(PCI_ADDR_PORT, addr);
+      outw(PCI_DATA_PORT + (addr & 2), value);
+    }
 }
 
 
@@ -65,8 +164,14 @@ pci_write_word(unsigned addr, unsigned short value)
 void
 pci_write_long(unsigned addr, unsigned value)
 {
-  outl(PCI_ADDR_PORT, addr);
-  outl(PCI_DATA_PORT, value);
+  volatile void *p = pci_ecam(addr & ~3);
+  if (p)
+    mmio_config_writel(p, value);
+  else
+    {
+      outl(PCI_ADDR_PORT, addr);
+      outl(PCI_DATA_PORT, value);
+    }
 }
 
 
@@ -77,41 +182,131 @@ static inline
 unsigned short
 pci_read_word_aligned(unsigned addr)
 {
-  outl(PCI_ADDR_PORT, addr);
-  return inw(PCI_DATA_PORT);
+  return pci_read_word(addr);
 }
 
 static inline
 void
 pci_write_word_aligned(unsigned addr, unsigned short value)
 {
-  outl(PCI_ADDR_PORT, addr);
-  outw(PCI_DATA_PORT, value);
+  pci_write_word(addr, value);
 }
 
 
 /**
- * Return an pci config space address of a device with the given
- * class/subclass id or 0 on error.
- *
- * Note: this returns the last device found!
+ * The device tree found by pci_scan().
  */
-unsigned
-pci_find_device_per_class(unsigned short class)
+static struct pci_dev pci_devices[PCI_MAX_DEVICES];
+static unsigned pci_count;
+static int pci_scanned;
+static unsigned pci_buses[256 / 32];
+
+
+/**
+ * Enumerate the devices on a bus and recurse into the secondary bus
+ * of every pci-to-pci bridge.  Absent devices are skipped without
+ * probing their functions.  Buses are visited only once, so
+ * misconfigured bridges cannot lead to loops.
+ */
+static
+int
+pci_scan_bus(unsigned bus, unsigned short parent, unsigned char depth)
 {
-  unsigned res = 0;
-  for (unsigned i=0; i<1<<13; i++)
+  if (pci_buses[bus / 32] & (1 << (bus % 32)))
+    return 0;
+  pci_buses[bus / 32] |= 1 << (bus % 32);
+
+  for (unsigned i=0; i<32; i++)
     {
       unsigned char maxfunc = 0;
       for (unsigned func=0; func<=maxfunc; func++)
 	{
-	  unsigned addr = 0x80000000 | i<<11 | func<<8;
-	  if (!maxfunc && pci_read_byte(addr+14) & 0x80)
+	  unsigned addr = 0x80000000 | bus<<16 | i<<11 | func<<8;
+	  unsigned id = pci_read_long(addr);
+	  if (!id || id == 0xffffffff)
+	    continue;
+
+	  unsigned char header_type = pci_read_byte(addr+14);
+	  if (!func && header_type & 0x80)
 	    maxfunc=7;
-	  if (class == (pci_read_long(addr+0x8) >> 16))
-	    res = addr;
+
+	  CHECK3(-1, pci_count >= PCI_MAX_DEVICES, "too many pci devices");
+	  unsigned index = pci_count++;
+	  struct pci_dev *dev = pci_devices + index;
+	  dev->addr = addr;
+	  dev->id = id;
+	  dev->class = pci_read_long(addr+0x8) >> 16;
+	  dev->header_type = header_type;
+	  dev->parent = parent;
+	  dev->depth = depth;
+
+	  if ((header_type & 0x7f) == PCI_HEADER_BRIDGE)
+	    {
+	      unsigned char secondary = pci_read_byte(addr+PCI_CONF_SECONDARY_BUS);
+	      if (secondary > bus && pci_scan_bus(secondary, index, depth + 1))
+		return -1;
+	    }
 	}
     }
+  return 0;
+}
+
+
+/**
+ * Enumerate all pci devices once and remember them in pci_devices,
+ * so that later lookups need no config space accesses.  Bus 0 and the
+ * first bus of every MCFG entry of segment 0 are scanned as root
+ * buses.
+ *
+ * Returns 0 or -1 if there are more devices than fit into the table.
+ */
+static
+int
+pci_scan(void)
+{
+  if (pci_scanned)
+    return pci_scanned > 0 ? 0 : -1;
+  pci_init_ecam();
+  int res = pci_scan_bus(0, PCI_NO_PARENT, 0);
+
+  struct acpi_mcfg *mcfg = (struct acpi_mcfg *) acpi_find_table("MCFG");
+  if (mcfg)
+    for (struct acpi_mcfg_entry *e = mcfg->entries; !res && (char *)(e + 1) <= (char *)mcfg + mcfg->hdr.length; e++)
+      if (!e->segment)
+	res = pci_scan_bus(e->start_bus, PCI_NO_PARENT, 0);
+  pci_scanned = res ? -1 : 1;
+  return res;
+}
+
+
+/**
+ * Return the device tree.  Devices are in depth-first order and
+ * reference their bridge by index.
+ *
+ * Returns the number of devices or -1 if the table is incomplete.
+ */
+int
+pci_get_devices(struct pci_dev **devices)
+{
+  *devices = pci_devices;
+  return pci_scan() ? -1 : (int) pci_count;
+}
+
+
+/**
+ * Return an pci config space address of a device with the given
+ * class/subclass id or 0 on error.
+ *
+ * Note: this returns the last device found!
+ */
+unsigned
+pci_find_device_per_class(unsigned short class)
+{
+  unsigned res = 0;
+  CHECK3(0, pci_scan(), "pci scan incomplete");
+  for (unsigned i=0; i < pci_count; i++)
+    if (class == pci_devices[i].class)
+      res = pci_devices[i].addr;
   return res;
 }
 
@@ -125,18 +320,10 @@ unsigned
 pci_find_device(unsigned id)
 {
   unsigned res = 0;
-  for (unsigned i=0; i<1<<13; i++)
-    {
-      unsigned char maxfunc = 0;
-      for (unsigned func=0; func<=maxfunc; func++)
-	{
-	  unsigned addr = 0x80000000 | i<<11 | func<<8;
-	  if (!maxfunc && pci_read_byte(addr+14) & 0x80)
-	    maxfunc=7;
-	  if (id == (pci_read_long(addr+0x8)))
-	    res = addr;
-	}
-    }
+  CHECK3(0, pci_scan(), "pci scan incomplete");
+  for (unsigned i=0; i < pci_count; i++)
+    if (id == pci_devices[i].id)
+      res = pci_devices[i].addr;
   return res;
 }
 
@@ -237,47 +424,35 @@ pci_print_bars(unsigned addr, unsigned count)
 int
 pci_iterate_devices()
 {
-  for (unsigned bus=0; bus < 255; bus++)
-    for (unsigned dev=0; dev < 32; dev++)
-      {
-	unsigned char maxfunc = 0;
-	for (unsigned func=0; func<=maxfunc; func++)
-	  {
-	    unsigned addr = 0x80000000 | bus << 16 | dev << 11 | func << 8;
-	    unsigned value= pci_read_long(addr);
-	    unsigned class = pci_read_long(addr+0x8) >> 16;
-
-	    unsigned char header_type = pci_read_byte(addr+14);
-	    if (!maxfunc && header_type & 0x80)
-	      maxfunc=7;
-	    if (!value || value==0xffffffff)
-	      continue;
-#if 0
-	    myprintf("%x:%x.%x %x: %x:%x %x\n", bus, dev, func, class, value & 0xffff, value >> 16, header_type);
-#else
-	    out_hex(bus,7);
-	    out_char(':');
-	    out_hex(dev,4);
-	    out_char('.');
-	    out_hex(func, 3);
-	    out_char(' ');
-	    out_hex(class, 15);
-	    out_char(':');
-	    out_char(' ');
-	    out_hex(value & 0xffff, 15);
-	    out_char(':');
-	    out_hex(value >> 16, 15);
-	    out_char(' ');
-	    out_hex(header_type,7);
-	    out_char('\n');
-#endif
-	    //pci_print_bars(addr, header_type & 0x7f ? 2 : 6);
-	  }
-      }
+  CHECK3(-1, pci_scan(), "pci scan incomplete");
+  for (unsigned i=0; i < pci_count; i++)
+    {
+      struct pci_dev *dev = pci_devices + i;
+      for (unsigned j=0; j < dev->depth; j++)
+	out_string("  ");
+      out_hex((dev->addr >> 16) & 0xff, 7);
+      out_char(':');
+      out_hex((dev->addr >> 11) & 0x1f, 4);
+      out_char('.');
+      out_hex((dev->addr >> 8) & 0x7, 3);
+      out_char(' ');
+      out_hex(dev->class, 15);
+      out_char(':');
+      out_char(' ');
+      out_hex(dev->id & 0xffff, 15);
+      out_char(':');
+      out_hex(dev->id >> 16, 15);
+      out_char(' ');
+      out_hex(dev->header_type, 7);
+      out_char('\n');
+      //pci_print_bars(dev->addr, dev->header_type & 0x7f ? 2 : 6);
+    }
   return 0;
 }
+#endif
 
 
+#ifdef CONFIG_DEV
 /**
  * Read a DEV control or status register.
  * @param addr - pci config address of the capability header
@@ -304,16 +479,22 @@ dev_write_reg(unsigned addr, unsigned char func, unsigned char instance, unsigne
 }
 
 
+/**
+ * Returns the config address of the DEV capability or 0 on error, as
+ * the callers expect.
+ */
 static
 unsigned
 dev_get_addr()
 {
   unsigned addr;
+  unsigned char cap;
   addr = pci_find_device(DEV_PCI_DEVICE_ID_OLD);
   if (!addr) addr = pci_find_device(DEV_PCI_DEVICE_ID_K10);
-  CHECK3(-21, !addr, "device not found");
-  CHECK3(-22, !(addr = addr + pci_dev_find_cap(addr, DEV_PCI_CAP_ID)),"cap not found");
-  CHECK3(-23, 0xf != (pci_read_long(addr) & 0xf00ff),"invalid DEV_HDR");
+  CHECK3(0, !addr, "device not found");
+  CHECK3(0, !(cap = pci_dev_find_cap(addr, DEV_PCI_CAP_ID)),"cap not found");
+  addr += cap;
+  CHECK3(0, 0xf != (pci_read_long(addr) & 0xf00ff),"invalid DEV_HDR");
   return addr;
 }
 
@@ -332,6 +513,43 @@ disable_dev_protection()
 
 
 
+/**
+ * Set the bits of all pages touched by a range in a DEV bitmap.  Full
+ * words are updated at once.
+ */
+static
+void
+dev_bitmap_update(unsigned *bitmap, unsigned base, unsigned size)
+{
+  unsigned page = base >> 12;
+  unsigned end  = ((unsigned long long) base + size + 0xfff) >> 12;
+  if (end > 1 << 20)
+    end = 1 << 20;
+  while (page < end)
+    {
+      unsigned mask = ~0u << (page % 32);
+      if (end - (page & ~31) < 32)
+	mask &= (1u << (end % 32)) - 1;
+      bitmap[page / 32] |= mask;
+      page = (page | 31) + 1;
+    }
+}
+
+
+/**
+ * Returns true if there is a DEV and its bitmap is enabled.  Quiet
+ * on machines without a DEV.
+ */
+int
+dev_enabled(void)
+{
+  unsigned addr;
+  if (!pci_find_device(DEV_PCI_DEVICE_ID_OLD) && !pci_find_device(DEV_PCI_DEVICE_ID_K10))
+    return 0;
+  return (addr = dev_get_addr()) && dev_read_reg(addr, DEV_REG_CR, 0) & DEV_CR_EN;
+}
+
+
 static
 int
 enable_dev_bitmap(unsigned addr, unsigned base)
@@ -341,7 +559,7 @@ enable_dev_bitmap(unsigned addr, unsigned base)
   while (dom--)
     {
       dev_write_reg(addr, DEV_REG_BASE_HI, dom, 0);
-      dev_write_reg(addr, DEV_REG_BASE_HI, dom, base | 3);
+      dev_write_reg(addr, DEV_REG_BASE_LO, dom, base | 3);
     }
   dev_write_reg(addr, DEV_REG_CR, 0, dev_read_reg(addr, DEV_REG_CR, 0) | DEV_CR_EN | DEV_CR_INVD);
   return 0;
@@ -349,13 +567,28 @@ enable_dev_bitmap(unsigned addr, unsigned base)
 
 
 /**
- * Enable dev protection for all memory.
+ * Protect a zero terminated string.
+ */
+static
+void
+dev_bitmap_string(unsigned *bitmap, unsigned string)
+{
+  if (string)
+    dev_bitmap_update(bitmap, string, strlen((char *) string) + 1);
+}
+
+
+/**
+ * Enable dev protection for the loader, the MBI with all modules,
+ * the trampoline and the bitmap itself. All other memory stays
+ * DMA-able.
  *
  * @param sldev_buffer - SLDEV protected buffer of 4k size (above 128k).
  * @param buffer - 128k buffer to hold the DEV bitmap of 128k size and 4k alignment.
+ * @param mbi - the multiboot info describing the modules.
  */
 int
-enable_dev_protection(unsigned *sldev_buffer, unsigned char *buffer)
+enable_dev_protection(unsigned *sldev_buffer, unsigned char *buffer, struct mbi *mbi)
 {
   unsigned addr;
   out_info("enable DEV protection");
@@ -374,9 +607,29 @@ enable_dev_protection(unsigned *sldev_buffer, unsigned char *buffer)
   enable_dev_bitmap(addr, (base+0xfff) & 0xfffff000);
 
   /**
-   * Now we have the dev bitmap protected - initialize and enable them.
+   * Now we have the dev bitmap protected - build the real one from
+   * the memory layout and enable it.
    */
-  memset(buffer, 0xff, 1<<17);
-  enable_dev_bitmap(addr, base);
+  unsigned *bitmap = (unsigned *) buffer;
+  memset(bitmap, 0, 1<<17);
+  dev_bitmap_update(bitmap, (unsigned) buffer, 1<<17);
+  dev_bitmap_update(bitmap, (unsigned) sldev_buffer, 1<<12);
+  dev_bitmap_update(bitmap, TRAMPOLINE_ADDRESS, 1<<12);
+  dev_bitmap_update(bitmap, (unsigned) &__IMAGE_START__, &__IMAGE_END__ - &__IMAGE_START__);
+  dev_bitmap_update(bitmap, (unsigned) mbi, sizeof(*mbi));
+  if (mbi->flags & MBI_FLAG_CMDLINE)
+    dev_bitmap_string(bitmap, mbi->cmdline);
+  if (mbi->flags & MBI_FLAG_MODS)
+    {
+      struct module *m = (struct module *) mbi->mods_addr;
+      dev_bitmap_update(bitmap, mbi->mods_addr, mbi->mods_count * sizeof(*m));
+      for (unsigned i=0; i < mbi->mods_count; i++, m++)
+	{
+	  dev_bitmap_update(bitmap, m->mod_start, m->mod_end - m->mod_start);
+	  dev_bitmap_string(bitmap, m->string);
+	}
+    }
+  enable_dev_bitmap(addr, (unsigned) buffer);
   return 0;
 }
+#endif
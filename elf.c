@@ -14,10 +14,11 @@
 
 #include <elf.h>
 #include <util.h>
+#include <trace.h>
+#include <mtrr.h>
 
 enum {
   EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI,
-  TRAMPOLINE_ADDRESS = 0x7c00,
 };
 
 static void
@@ -39,9 +40,64 @@ gen_mov(unsigned char **code, int reg, unsigned constant)
 }
 
 static void
-gen_jmp_edx(unsigned char **code)
+gen_jmp(unsigned char **code, int reg)
 {
-  byte_out(code, 0xFF); byte_out(code, 0xE2);
+  byte_out(code, 0xFF); byte_out(code, 0xE0 | reg);
+}
+
+static void
+gen_wrmsr(unsigned char **code, unsigned msr, unsigned long long value)
+{
+  gen_mov(code, ECX, msr);
+  gen_mov(code, EAX, value);
+  gen_mov(code, EDX, value >> 32);
+  byte_out(code, 0x0F); byte_out(code, 0x30);   /* WRMSR */
+}
+
+static void
+gen_cr0(unsigned char **code, unsigned value)
+{
+  gen_mov(code, EAX, value);
+  byte_out(code, 0x0F); byte_out(code, 0x22); byte_out(code, 0xC0);  /* MOV CR0, EAX */
+}
+
+static void
+gen_wbinvd(unsigned char **code)
+{
+  byte_out(code, 0x0F); byte_out(code, 0x09);   /* WBINVD */
+}
+
+/**
+ * Generate the code that restores the MTRRs changed by
+ * mtrr_set_wb(), so that the segments are still copied write-back.
+ * The sequence is the one of mtrr_write().
+ */
+static void
+gen_mtrr_restore(unsigned char **code)
+{
+  unsigned long long base, mask, def = 0;
+  unsigned cr0 = 0;
+  unsigned changed = 0;
+  for (unsigned i=0; i < MTRR_MAX_VAR; i++)
+    if (mtrr_saved(i, &base, &mask))
+      {
+	if (!changed++)
+	  {
+	    def = rdmsr(MSR_MTRR_DEF_TYPE);
+	    cr0 = read_cr0();
+	    gen_cr0(code, (cr0 | CR0_CD) & ~CR0_NW);
+	    gen_wbinvd(code);
+	    gen_wrmsr(code, MSR_MTRR_DEF_TYPE, def & ~MTRR_DEF_E);
+	  }
+	gen_wrmsr(code, MSR_MTRR_BASE + 2*i, base);
+	gen_wrmsr(code, MSR_MTRR_BASE + 2*i + 1, mask);
+      }
+  if (changed)
+    {
+      gen_wbinvd(code);
+      gen_wrmsr(code, MSR_MTRR_DEF_TYPE, def);
+      gen_cr0(code, cr0);
+    }
 }
 
 static void
@@ -59,9 +115,36 @@ gen_elf_segment(unsigned char **code, void *target, void *src, unsigned len,
   byte_out(code, 0xAA);         /* STOSB */
 }
 
+/**
+ * Check the ELF header of a module and generate the code that copies
+ * its loadable segments in place.
+ *
+ * Returns the entry point of the module.
+ */
+static unsigned
+gen_elf_module(unsigned char **code, struct module *m)
+{
+  // check elf header
+  struct eh *elf = (struct eh *) m->mod_start;
+  ERROR(-31, *((unsigned *) elf->e_ident) != ELF_MAGIC || *((short *) elf->e_ident+2) != 0x0101, "ELF header incorrect");
+  ERROR(-32, elf->e_type!=2 || elf->e_machine!=3 || elf->e_version!=1, "ELF type incorrect");
+  ERROR(-33, sizeof(struct ph) > elf->e_phentsize, "e_phentsize to small");
+
+  for (unsigned i=0; i<elf->e_phnum; i++) {
+    struct ph *ph = (struct ph *)(m->mod_start + elf->e_phoff+ i*elf->e_phentsize);
+    if (ph->p_type != 1)
+      continue;
+    gen_elf_segment(code, ph->p_paddr, (void *)(m->mod_start+ph->p_offset), ph->p_filesz,
+		    ph->p_memsz - ph->p_filesz);
+  }
+  return elf->e_entry;
+}
+
+
 int
 start_module(struct mbi *mbi)
 {
+  trace("elf");
   if (mbi->mods_count == 0) {
     out_info("No module to start.\n");
     return -1;
@@ -76,30 +159,56 @@ start_module(struct mbi *mbi)
   // switch it on unconditionally, we assume that m->string is always initialized
   mbi->flags |=  MBI_FLAG_CMDLINE;
 
-  // check elf header
-  struct eh *elf = (struct eh *) m->mod_start;
-  ERROR(-31, *((unsigned *) elf->e_ident) != 0x464c457f || *((short *) elf->e_ident+2) != 0x0101, "ELF header incorrect");
-  ERROR(-32, elf->e_type!=2 || elf->e_machine!=3 || elf->e_version!=1, "ELF type incorrect");
-  ERROR(-33, sizeof(struct ph) > elf->e_phentsize, "e_phentsize to small");
-
   unsigned char *code = (unsigned char *) TRAMPOLINE_ADDRESS;
-
-  for (unsigned i=0; i<elf->e_phnum; i++) {
-    struct ph *ph = (struct ph *)(m->mod_start + elf->e_phoff+ i*elf->e_phentsize);
-    if (ph->p_type != 1)
-      continue;
-    gen_elf_segment(&code, ph->p_paddr, (void *)(m->mod_start+ph->p_offset), ph->p_filesz,
-		    ph->p_memsz - ph->p_filesz);
-  }
+  unsigned entry = gen_elf_module(&code, m);
+  gen_mtrr_restore(&code);
 
   gen_mov(&code, EAX, 0x2BADB002);
-  gen_mov(&code, EDX, (unsigned)elf->e_entry);
-  gen_jmp_edx(&code);
+  gen_mov(&code, EDX, entry);
+  gen_jmp(&code, EDX);
 
+  trace("start");
+  trace_dump();
   asm volatile  ("jmp *%%edx" :: "a" (0), "d" (TRAMPOLINE_ADDRESS), "b" (mbi));
 
   /* NOT REACHED */
   return 0;
 }
 
+
+/**
+ * Copy the segments of an ELF module in place, restore the MTRRs
+ * and jump to func with the entry point in eax and param in edx.
+ *
+ * The segments are copied forward, thus they must not overlap the
+ * module itself.  Only 32-bit images are supported, as a 64-bit
+ * vmlinux has to be entered in long mode.
+ *
+ * Note: func has to be outside of the loaded segments.
+ */
+void
+start_elf(struct module *m, void *func, unsigned param)
+{
+  struct eh *elf = (struct eh *) m->mod_start;
+  ERROR(-34, elf->e_ident[4] == 2, "64-bit ELF images are not supported");
+  for (unsigned i=0; i<elf->e_phnum; i++) {
+    struct ph *ph = (struct ph *)(m->mod_start + elf->e_phoff+ i*elf->e_phentsize);
+    unsigned start = (unsigned) ph->p_paddr;
+    ERROR(-35, ph->p_type == 1 && start < m->mod_end && start + ph->p_memsz > m->mod_start,
+	  "ELF segment overlaps the image");
+  }
+
+  unsigned char *code = (unsigned char *) TRAMPOLINE_ADDRESS;
+  unsigned entry = gen_elf_module(&code, m);
+  gen_mtrr_restore(&code);
+
+  gen_mov(&code, EAX, entry);
+  gen_mov(&code, EDX, param);
+  gen_mov(&code, ECX, (unsigned) func);
+  gen_jmp(&code, ECX);
+
+  asm volatile  ("jmp *%%edx" :: "a" (0), "d" (TRAMPOLINE_ADDRESS));
+  __builtin_unreachable();
+}
+
 /* EOF */
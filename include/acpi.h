@@ -0,0 +1,103 @@
+/*
+ * \brief   ACPI structures and header of acpi.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+
+struct acpi_rsdp
+{
+  char               signature[8];
+  unsigned char      checksum;
+  char               oemid[6];
+  unsigned char      revision;
+  unsigned int       rsdt;
+  unsigned int       length;
+  unsigned long long xsdt;
+  unsigned char      xchecksum;
+  unsigned char      reserved[3];
+} __attribute__((packed));
+
+
+struct acpi_table
+{
+  char               signature[4];
+  unsigned int       length;
+  unsigned char      revision;
+  unsigned char      checksum;
+  char               oemid[6];
+  char               oemtableid[8];
+  unsigned int       oemrevision;
+  unsigned int       creatorid;
+  unsigned int       creatorrevision;
+} __attribute__((packed));
+
+
+struct acpi_mcfg_entry
+{
+  unsigned long long base;
+  unsigned short     segment;
+  unsigned char      start_bus;
+  unsigned char      end_bus;
+  unsigned int       reserved;
+} __attribute__((packed));
+
+
+struct acpi_mcfg
+{
+  struct acpi_table  hdr;
+  unsigned char      reserved[8];
+  struct acpi_mcfg_entry entries[];
+} __attribute__((packed));
+
+
+enum acpi_madt_types {
+  ACPI_MADT_LAPIC      = 0x00,
+  ACPI_MADT_X2APIC     = 0x09,
+  ACPI_MADT_MP_WAKEUP  = 0x10,
+  ACPI_MADT_ENABLED    = 1 << 0,
+};
+
+
+struct acpi_madt
+{
+  struct acpi_table  hdr;
+  unsigned int       lapic_addr;
+  unsigned int       flags;
+} __attribute__((packed));
+
+
+struct acpi_subtable
+{
+  unsigned char      type;
+  unsigned char      length;
+} __attribute__((packed));
+
+
+/**
+ * The multiprocessor wakeup structure of ACPI 6.4.
+ */
+struct acpi_madt_mp_wakeup
+{
+  unsigned char      type;
+  unsigned char      length;
+  unsigned short     mailbox_version;
+  unsigned int       reserved;
+  unsigned long long mailbox_addr;
+} __attribute__((packed));
+
+
+unsigned char acpi_checksum(const void *data, unsigned len);
+struct acpi_rsdp *acpi_find_rsdp(void);
+struct acpi_table *acpi_find_table(const char *signature);
+void acpi_fix_checksum(struct acpi_table *table);
+int acpi_replace_table(struct acpi_table *old, struct acpi_table *new);
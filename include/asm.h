@@ -51,6 +51,16 @@ cpuid_eax(unsigned value)
 }
 
 
+static inline
+unsigned int
+cpuid_ebx(unsigned value)
+{
+  unsigned int res, dummy;
+  asm volatile ("cpuid" :  "=b"(res), "=a"(dummy): "a"(value) : "ecx", "edx");
+  return res;
+}
+
+
 static inline
 unsigned int
 cpuid_ecx(unsigned value)
@@ -92,6 +102,32 @@ wrmsr(unsigned int addr, unsigned long long value)
 }
 
 
+static inline
+unsigned
+read_cr0(void)
+{
+  unsigned res;
+  asm volatile ("mov %%cr0, %0" : "=r"(res));
+  return res;
+}
+
+
+static inline
+void
+write_cr0(unsigned value)
+{
+  asm volatile ("mov %0, %%cr0" :: "r"(value));
+}
+
+
+static inline
+void
+wbinvd(void)
+{
+  asm volatile ("wbinvd" ::: "memory");
+}
+
+
 static inline
 unsigned char
 inb(const unsigned short port)
@@ -146,6 +182,57 @@ outl(const unsigned short port, unsigned value)
 }
 
 
+/**
+ * Accesses to the memory mapped pci config space.  The northbridge of
+ * AMD family 10h and later processors supports them only with eAX as
+ * data register.
+ */
+static inline
+unsigned char
+mmio_config_readb(volatile void *addr)
+{
+  unsigned char res;
+  asm volatile("movb (%1),%%al" : "=a"(res) : "r"(addr) : "memory");
+  return res;
+}
+
+
+static inline
+unsigned short
+mmio_config_readw(volatile void *addr)
+{
+  unsigned short res;
+  asm volatile("movw (%1),%%ax" : "=a"(res) : "r"(addr) : "memory");
+  return res;
+}
+
+
+static inline
+unsigned
+mmio_config_readl(volatile void *addr)
+{
+  unsigned res;
+  asm volatile("movl (%1),%%eax" : "=a"(res) : "r"(addr) : "memory");
+  return res;
+}
+
+
+static inline
+void
+mmio_config_writew(volatile void *addr, unsigned short value)
+{
+  asm volatile("movw %%ax,(%1)" :: "a"(value), "r"(addr) : "memory");
+}
+
+
+static inline
+void
+mmio_config_writel(volatile void *addr, unsigned value)
+{
+  asm volatile("movl %%eax,(%1)" :: "a"(value), "r"(addr) : "memory");
+}
+
+
 static inline
 unsigned
 bsr(unsigned int value)
@@ -16,7 +16,7 @@
 #ifndef _BOOT_LINUX_H_
 #define _BOOT_LINUX_H_
 
-void jmp_kernel(unsigned cs, unsigned stack) __attribute__((noreturn));
+void jmp_kernel32(unsigned entry, void *boot_params) __attribute__((noreturn));
 extern char smp_init_start;
 extern char smp_init_end;
 
@@ -0,0 +1,78 @@
+/*
+ * \brief   CRB data structures and header of crb.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+enum crb_intf_type
+  {
+    TPM_INTF_ID        = 0x30,
+    TPM_INTF_TYPE_MASK = 0xf,
+    TPM_INTF_FIFO      = 0x0,
+    TPM_INTF_CRB       = 0x1,
+    TPM_INTF_TIS       = 0xf,
+  };
+
+
+/**
+ * The registers of a CRB locality as defined by the PC Client
+ * Platform TPM Profile.
+ */
+struct crb_mmap
+{
+  unsigned int   loc_state;
+  unsigned int   __dummy1;
+  unsigned int   loc_ctrl;
+  unsigned int   loc_sts;
+  unsigned char  __dummy2[32];
+  unsigned int   intf_id;
+  unsigned int   did_vid;
+  unsigned int   ctrl_ext[2];
+  unsigned int   ctrl_req;
+  unsigned int   ctrl_sts;
+  unsigned int   ctrl_cancel;
+  unsigned int   ctrl_start;
+  unsigned int   int_enable;
+  unsigned int   int_sts;
+  unsigned int   cmd_size;
+  unsigned int   cmd_laddr;
+  unsigned int   cmd_haddr;
+  unsigned int   rsp_size;
+  unsigned int   rsp_laddr;
+  unsigned int   rsp_haddr;
+};
+
+
+enum crb_bits
+  {
+    CRB_LOC_STATE_ASSIGNED = 1<<1,
+    CRB_LOC_STATE_VALID    = 1<<7,
+    CRB_LOC_CTRL_REQUEST   = 1<<0,
+    CRB_LOC_CTRL_RELINQUISH= 1<<1,
+    CRB_LOC_CTRL_SEIZE     = 1<<2,
+    CRB_LOC_STS_GRANTED    = 1<<0,
+    CRB_CTRL_REQ_READY     = 1<<0,
+    CRB_CTRL_REQ_IDLE      = 1<<1,
+    CRB_CTRL_STS_ERROR     = 1<<0,
+    CRB_CTRL_START         = 1<<0,
+    CRB_RESPONSE_HEADER    = 6,
+  };
+
+
+int crb_access(unsigned locality, int force);
+int crb_deactivate_all(unsigned base);
+int crb_transmit_start(unsigned locality,
+		       const unsigned char *write_buffer,
+		       unsigned write_count);
+int crb_transmit_finish(unsigned locality,
+			unsigned char *read_buffer,
+			unsigned read_count);
@@ -14,12 +14,41 @@
 
 #pragma once
 
+#include "mbi.h"
+
 enum pci_constants {
   PCI_ADDR_PORT = 0xcf8,
   PCI_DATA_PORT = 0xcfc,
   PCI_CONF_HDR_CMD = 4,
   PCI_CONF_HDR_CAP = 52,
+  PCI_CONF_SECONDARY_BUS = 0x19,
+  PCI_HEADER_BRIDGE = 1,
+  PCI_NO_PARENT = 0xffff,
   PCI_CAP_OFFSET = 1,
+  PCI_MAX_DEVICES = 1024,
+};
+
+enum ecam_constants {
+  MSR_MMIO_CFG_BASE = 0xc0010058,
+  MMIO_CFG_ENABLE = 1<<0,
+  MMIO_CFG_BUS_RANGE_SHIFT = 2,
+  MMIO_CFG_BASE_MASK = 0xfff00000,
+};
+
+
+/**
+ * A pci device found during the enumeration. The parent is the index
+ * of the bridge the device sits behind or PCI_NO_PARENT on a root
+ * bus.
+ */
+struct pci_dev
+{
+  unsigned addr;
+  unsigned id;
+  unsigned short class;
+  unsigned char header_type;
+  unsigned char depth;
+  unsigned short parent;
 };
 
 enum dev_constants {
@@ -52,8 +81,37 @@ enum dev_cr {
 };
 
 
+#ifdef CONFIG_DEV
+int enable_dev_protection(unsigned *sldev_buffer, unsigned char *buffer, struct mbi *mbi);
 int disable_dev_protection();
+int dev_enabled(void);
+#else
+static inline
+int
+disable_dev_protection()
+{
+  return -1;
+}
+
+static inline
+int
+dev_enabled(void)
+{
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_PCI
 int pci_iterate_devices();
+int pci_get_devices(struct pci_dev **devices);
 unsigned pci_read_long(unsigned addr);
 void pci_write_long(unsigned addr, unsigned value);
 unsigned pci_find_device_per_class(unsigned short class);
+#else
+static inline
+int
+pci_iterate_devices()
+{
+  return 0;
+}
+#endif
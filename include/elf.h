@@ -16,6 +16,12 @@
 
 #include "mbi.h"
 
+enum elf_enum
+  {
+    ELF_MAGIC = 0x464c457f,
+    TRAMPOLINE_ADDRESS = 0x7c00,
+  };
+
 
 struct eh
 {
@@ -49,3 +55,4 @@ struct ph {
 
 int start_module(struct mbi *mbi);
 int extract_module(struct mbi *mbi, unsigned *entry_point);
+void start_elf(struct module *m, void *func, unsigned param) __attribute__((noreturn));
@@ -0,0 +1,22 @@
+/*
+ * \brief   header of lz4.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+enum lz4_enum
+  {
+    LZ4_LEGACY_MAGIC = 0x184C2102,
+  };
+
+unsigned lz4_size(const unsigned char *src, unsigned src_size);
+int lz4_decompress(unsigned char *dst, unsigned dst_size, const unsigned char *src, unsigned src_size);
@@ -0,0 +1,44 @@
+/*
+ * \brief   header of mem.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+#include "mbi.h"
+
+enum mem_enum
+  {
+    MEM_PAGE_SIZE   = 0x1000,
+    MEM_MAX_REGIONS = 64,
+    MEM_TYPE_RAM    = 1,
+    MEM_TYPE_RESERVED = 2,
+  };
+
+
+/**
+ * A free region of physical memory [base, end).
+ */
+struct region
+{
+  unsigned base;
+  unsigned end;
+};
+
+
+extern char __IMAGE_START__;
+extern char __IMAGE_END__;
+
+int mem_init(struct mbi *mbi);
+void mem_reserve(unsigned base, unsigned size);
+unsigned mem_alloc(unsigned size, unsigned limit);
+int mem_mmap_reserve(struct mbi *mbi, unsigned base, unsigned size);
+void mem_dump(void);
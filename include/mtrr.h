@@ -0,0 +1,67 @@
+/*
+ * \brief   header of mtrr.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+enum mtrr_msrs
+  {
+    MSR_MTRR_CAP       = 0xfe,
+    MSR_MTRR_BASE      = 0x200,
+    MSR_MTRR_FIX_64K   = 0x250,
+    MSR_MTRR_FIX_16K   = 0x258,
+    MSR_MTRR_FIX_4K    = 0x268,
+    MSR_MTRR_DEF_TYPE  = 0x2ff,
+  };
+
+
+enum mtrr_bits
+  {
+    MTRR_CAP_VCNT      = 0xff,
+    MTRR_CAP_FIX       = 1 << 8,
+    MTRR_DEF_FE        = 1 << 10,
+    MTRR_DEF_E         = 1 << 11,
+    MTRR_MASK_VALID    = 1 << 11,
+    MTRR_MAX_VAR       = 16,
+    CPUID_EDX_MTRR     = 1 << 12,
+    CR0_CD             = 1 << 30,
+    CR0_NW             = 1 << 29,
+  };
+
+
+enum mtrr_types
+  {
+    MTRR_UC = 0,
+    MTRR_WC = 1,
+    MTRR_WT = 4,
+    MTRR_WP = 5,
+    MTRR_WB = 6,
+  };
+
+
+#ifdef CONFIG_MTRR
+unsigned mtrr_type(unsigned long long base, unsigned long long size);
+int mtrr_set_wb(unsigned base, unsigned size);
+void mtrr_restore(void);
+int mtrr_saved(unsigned i, unsigned long long *base, unsigned long long *mask);
+#else
+static inline int mtrr_set_wb(unsigned base, unsigned size) { (void) base; (void) size; return -1; }
+static inline void mtrr_restore(void) {}
+
+static inline
+int
+mtrr_saved(unsigned i, unsigned long long *base, unsigned long long *mask)
+{
+  (void) i; (void) base; (void) mask;
+  return 0;
+}
+#endif
@@ -20,6 +20,14 @@ enum linux_enum
   {
     LINUX_HEADER_MAGIC        = 0x53726448,
     LINUX_BOOT_FLAG_MAGIC     = 0xAA55,
+    LINUX_LOADED_HIGH         = 0x01,
+    LINUX_INITRD_ADDR_MAX     = 0x37ffffff,
+    LINUX_E820_MAX            = 128,
+    LINUX_BOOT_CS             = 0x10,
+    LINUX_BOOT_DS             = 0x18,
+    LINUX_SETUP_DATA_VERSION  = 0x209,
+    LINUX_INIT_SIZE_VERSION   = 0x20a,
+    LINUX_SETUP_OSLO          = 0x4f534c4f,
   };
 
 struct linux_kernel_header
@@ -48,6 +56,65 @@ struct linux_kernel_header
   unsigned short    pad1;
   unsigned int      cmd_line_ptr;
   unsigned int      initrd_addr_max;
+  unsigned int      kernel_alignment;
+  unsigned char     relocatable_kernel;
+  unsigned char     min_alignment;
+  unsigned short    xloadflags;
+  unsigned int      cmdline_size;
+  unsigned int      hardware_subarch;
+  unsigned long long hardware_subarch_data;
+  unsigned int      payload_offset;
+  unsigned int      payload_length;
+  unsigned long long setup_data;
+  unsigned long long pref_address;
+  unsigned int      init_size;
+} __attribute__((packed));
+
+
+/**
+ * An entry of the setup_data list.  The data follows.
+ */
+struct setup_data
+{
+  unsigned long long next;
+  unsigned int       type;
+  unsigned int       len;
+} __attribute__((packed));
+
+
+struct e820entry
+{
+  unsigned long long addr;
+  unsigned long long size;
+  unsigned int       type;
+} __attribute__((packed));
+
+
+/**
+ * The "zero page" as defined in the linux boot protocol. Only the
+ * fields that we fill out are named.
+ */
+struct boot_params
+{
+  unsigned char     orig_x;
+  unsigned char     orig_y;
+  unsigned short    ext_mem_k;
+  unsigned short    orig_video_page;
+  unsigned char     orig_video_mode;
+  unsigned char     orig_video_cols;
+  unsigned char     __dummy0[6];
+  unsigned char     orig_video_lines;
+  unsigned char     orig_video_isVGA;
+  unsigned short    orig_video_points;
+  unsigned char     __dummy1[0x1e0 - 0x12];
+  unsigned int      alt_mem_k;
+  unsigned char     __dummy2[4];
+  unsigned char     e820_entries;
+  unsigned char     __dummy3[0x1f1 - 0x1e9];
+  struct linux_kernel_header hdr;
+  unsigned char     __dummy4[0x2d0 - 0x264];
+  struct e820entry  e820_map[LINUX_E820_MAX];
+  unsigned char     __dummy5[0x1000 - 0xcd0];
 } __attribute__((packed));
 
 
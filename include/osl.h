@@ -15,5 +15,11 @@
 #pragma once
 #include "mbi.h"
 
+extern char __LOADER_START__;
+extern char __LOADER_END__;
+extern char __OSLO_END__;
+
 int _main(struct mbi *local_mbi, unsigned flags);
 int osl(struct mbi *mbi);
+int oslo(struct mbi *mbi);
+void slb_stub(struct mbi *mbi) __attribute__((noreturn));
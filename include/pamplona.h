@@ -14,5 +14,42 @@
 
 #pragma once
 
+/**
+ * Layout of the memory where the APs are parked.  The MADT copy
+ * follows the page tables.
+ */
+enum park_layout {
+  PARK_CODE    = 0x0000,
+  PARK_MAILBOX = 0x1000,
+  PARK_PML4    = 0x2000,
+  PARK_PDPT    = 0x3000,
+  PARK_PD      = 0x4000,
+  PARK_MADT    = 0x8000,
+  PARK_TIMEOUT = 100,
+  PTE_PRESENT  = 1 << 0,
+  PTE_WRITE    = 1 << 1,
+  PTE_LARGE    = 1 << 7,
+};
+
+
+/**
+ * The mailbox of the ACPI multiprocessor wakeup structure.
+ */
+struct park_mailbox
+{
+  unsigned short     command;
+  unsigned short     reserved;
+  unsigned int       apic_id;
+  unsigned long long wakeup_vector;
+};
+
+
 extern char smp_init_start;
 extern char smp_init_end;
+extern char smp_long;
+extern char smp_gdt;
+extern char smp_gdt_desc;
+extern char smp_long_jump;
+extern char smp_cr3;
+extern char smp_mailbox;
+extern char smp_parked;
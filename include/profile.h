@@ -0,0 +1,67 @@
+/*
+ * \brief   header of profile.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+/**
+ * The samples per second, e.g. 'make PROFILE_RATE=1000'.
+ */
+#ifndef PROFILE_RATE
+#define PROFILE_RATE 10000
+#endif
+
+enum profile_enum
+  {
+    PROFILE_SAMPLES       = 8192,
+    PROFILE_VECTOR        = 0xf0,
+    PROFILE_SPURIOUS      = 0xff,
+    PROFILE_CALIBRATE_MS  = 10,
+    IDT_INTERRUPT_GATE    = 0x8e00,
+    PIC_MASTER_DATA       = 0x21,
+    PIC_SLAVE_DATA        = 0xa1,
+    APIC_EOI              = 0xb0,
+    APIC_SVR              = 0xf0,
+    APIC_SVR_ENABLE       = 1 << 8,
+    APIC_LVT_TIMER        = 0x320,
+    APIC_LVT_MASKED       = 1 << 16,
+    APIC_LVT_PERIODIC     = 1 << 17,
+    APIC_TIMER_INIT       = 0x380,
+    APIC_TIMER_CURRENT    = 0x390,
+    APIC_TIMER_DIVIDE     = 0x3e0,
+    APIC_TIMER_DIVIDE_1   = 0xb,
+  };
+
+
+/**
+ * A 32-bit interrupt gate.
+ */
+struct idt_gate
+{
+  unsigned short offset_low;
+  unsigned short selector;
+  unsigned short flags;
+  unsigned short offset_high;
+};
+
+
+void profile_irq(void);
+void profile_spurious(void);
+void profile_sample(unsigned eip);
+
+#ifdef CONFIG_PROFILE
+void profile_start(void);
+void profile_stop(void);
+#else
+static inline void profile_start(void) {}
+static inline void profile_stop(void) {}
+#endif
@@ -17,7 +17,7 @@
 struct Context
 {
   unsigned int index;
-  unsigned long blocks;
+  unsigned blocks;
   unsigned char buffer[64+4];
   unsigned char hash[20];
 };
@@ -0,0 +1,27 @@
+/*
+ * \brief   header of sha256.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+struct Sha256Context
+{
+  unsigned int index;
+  unsigned blocks;
+  unsigned char buffer[64];
+  unsigned int state[8];
+  unsigned char hash[32];
+};
+
+void sha256_init(struct Sha256Context *ctx);
+void sha256(struct Sha256Context *ctx, unsigned char* value, unsigned count);
+void sha256_finish(struct Sha256Context *ctx);
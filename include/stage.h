@@ -0,0 +1,38 @@
+/*
+ * \brief   Stages of the combined image.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+#include "mbi.h"
+
+enum stage_flags {
+  STAGE_TPM   = 1 << 0,
+  STAGE_FINAL = 1 << 1,
+};
+
+
+/**
+ * A stage that could be selected on the command line.
+ */
+struct stage
+{
+  const char *name;
+  const char *label;
+  int (*func)(struct mbi *mbi);
+  unsigned flags;
+};
+
+
+int beirut(struct mbi *mbi);
+int pamplona(struct mbi *mbi);
+int start_linux(struct mbi *mbi);
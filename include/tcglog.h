@@ -0,0 +1,122 @@
+/*
+ * \brief   TCG event log structures and header of tcglog.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+#include "mbi.h"
+#include "tpm2.h"
+
+#define OSLO_HANDOFF_NAME "oslo_handoff"
+
+enum tcglog_enum
+  {
+    EV_NO_ACTION       = 0x03,
+    EV_IPL             = 0x0d,
+    TCGLOG_EVENT_SIZE  = 96,
+    TCGLOG_BASE_SIZE   = 512,
+    OSLO_HANDOFF_MAGIC = 0x484c534f, /* "OSLH" */
+    OSLO_HANDOFF_VERSION = 1,
+    OSLO_HANDOFF_PCRS  = 1 << 0,
+    OSLO_HANDOFF_DRYRUN = 1 << 1,
+  };
+
+
+/**
+ * The header of the first event in the SHA1 format.
+ */
+struct tcg_pcr_event
+{
+  unsigned int       pcr;
+  unsigned int       type;
+  unsigned char      digest[20];
+  unsigned int       size;
+} __attribute__((packed));
+
+
+/**
+ * The Spec ID Event03 that describes the crypto agile format.
+ */
+struct tcg_spec_id_event
+{
+  char               signature[16];
+  unsigned int       platform_class;
+  unsigned char      spec_version_minor;
+  unsigned char      spec_version_major;
+  unsigned char      spec_errata;
+  unsigned char      uintn_size;
+  unsigned int       algorithms;
+} __attribute__((packed));
+
+
+/**
+ * The data of a module event.  The command line follows.
+ */
+struct tcglog_module
+{
+  unsigned int       index;
+  unsigned int       size;
+} __attribute__((packed));
+
+
+/**
+ * The header of the hand-off module.  The SHA1 digests of the
+ * modules and the event log follow at the given offsets.  The PCR
+ * values are only valid if OSLO_HANDOFF_PCRS is set in the flags.
+ * OSLO_HANDOFF_DRYRUN marks measurements done without skinit.
+ */
+struct oslo_handoff
+{
+  unsigned int       magic;
+  unsigned short     version;
+  unsigned short     flags;
+  unsigned int       size;
+  unsigned int       module_count;
+  unsigned int       module_offset;
+  unsigned int       log_offset;
+  unsigned int       log_size;
+  unsigned char      pcr17[20];
+  unsigned char      pcr19[20];
+  struct tis_info    tis;
+} __attribute__((packed));
+
+
+#ifdef CONFIG_TCGLOG
+int  tcglog_init(struct mbi *mbi, unsigned banks);
+void tcglog_event(unsigned pcr, unsigned type, unsigned char *sha1, unsigned char *sha256, const void *data, unsigned size);
+void tcglog_module(unsigned pcr, unsigned index, struct module *m, unsigned char *sha1, unsigned char *sha256);
+int  tcglog_handoff(struct mbi *mbi, unsigned char *pcr17, unsigned char *pcr19);
+#else
+static inline int tcglog_init(struct mbi *mbi, unsigned banks) { (void) mbi; (void) banks; return -1; }
+
+static inline
+void
+tcglog_event(unsigned pcr, unsigned type, unsigned char *sha1, unsigned char *sha256, const void *data, unsigned size)
+{
+  (void) pcr; (void) type; (void) sha1; (void) sha256; (void) data; (void) size;
+}
+
+static inline
+void
+tcglog_module(unsigned pcr, unsigned index, struct module *m, unsigned char *sha1, unsigned char *sha256)
+{
+  (void) pcr; (void) index; (void) m; (void) sha1; (void) sha256;
+}
+
+static inline
+int
+tcglog_handoff(struct mbi *mbi, unsigned char *pcr17, unsigned char *pcr19)
+{
+  (void) mbi; (void) pcr17; (void) pcr19;
+  return -1;
+}
+#endif
@@ -22,6 +22,7 @@ enum tis_init
     TIS_INIT_ATMEL = 3,
     TIS_INIT_BROADCOM = 4,
     TIS_INIT_QEMU = 5,
+    TIS_INIT_GENERIC = 6,
   };
 
 
@@ -37,6 +38,18 @@ enum tis_mem_offsets
   };
 
 
+/**
+ * The default TIS timeouts in milliseconds.
+ */
+enum tis_timeouts
+  {
+    TIS_TIMEOUT_A = 750,
+    TIS_TIMEOUT_B = 2000,
+    TIS_TIMEOUT_C = 750,
+    TIS_TIMEOUT_D = 750,
+  };
+
+
 struct tis_id
 {
   int did_vid;
@@ -86,10 +99,32 @@ enum tis_sts_bits
   };
 
 
+/**
+ * What tis_init() found out about the TPM.
+ */
+struct tis_info
+{
+  unsigned int   did_vid;
+  unsigned char  rid;
+  unsigned char  vendor;
+  unsigned char  interface;
+  unsigned char  __reserved;
+  unsigned int   intf_capability;
+  unsigned short timeout_a;
+  unsigned short timeout_b;
+  unsigned short timeout_c;
+  unsigned short timeout_d;
+} __attribute__((packed));
+
+
+extern struct tis_info tis_info;
+
 void tis_dump(void);
-enum tis_init tis_init(int tis_base);
+enum tis_init tis_init(unsigned tis_base);
 int tis_deactivate_all(void);
 int tis_access(int locality, int force);
+int tis_transmit_start(const unsigned char *write_buffer, unsigned write_count);
+int tis_transmit_finish(unsigned char *read_buffer, unsigned read_count);
 int tis_transmit(const unsigned char *write_buffer,
 		 unsigned write_count,
 		 unsigned char *read_buffer,
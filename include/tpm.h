@@ -39,15 +39,15 @@
     buffer[0] = 0x00;							\
     buffer[1] = 0xc1;							\
     size+=sizeof(send_buffer);						\
-    *(unsigned long *)(buffer+2) = ntohl(size);				\
+    *(unsigned int *)(buffer+2) = ntohl(size);				\
     assert(TCG_BUFFER_SIZE>=size);					\
     for (unsigned i=0; i<sizeof(send_buffer)/sizeof(*send_buffer); i++)	\
-      *((unsigned long *)(buffer+6)+i) = ntohl(send_buffer[i]);		\
+      *((unsigned int *)(buffer+6)+i) = ntohl(send_buffer[i]);		\
     ret = tis_transmit(buffer, size, buffer, TCG_BUFFER_SIZE);		\
     if (ret < 0)							\
       return ret;							\
     POSTCOND;								\
-    return ntohl(*(unsigned long *)(buffer+6));				\
+    return ntohl(*(unsigned int *)(buffer+6));				\
   }
 
 /**
@@ -61,7 +61,7 @@
  * Extract long values from the buffer.
  */
 #define TPM_EXTRACT_LONG(OFFSET)			\
-  ntohl(*(unsigned long *)(buffer+TCG_DATA_OFFSET+OFFSET))
+  ntohl(*(unsigned int *)(buffer+TCG_DATA_OFFSET+OFFSET))
 
 
 /**
@@ -79,6 +79,7 @@
 enum tpm_ords {
 	TPM_ORD_Extend=20,
 	TPM_ORD_PcrRead = 21,
+	TPM_ORD_ContinueSelfTest = 83,
 	TPM_ORD_GetCapability=101,
 	TPM_ORD_Startup = 153,
 };
@@ -100,6 +101,8 @@ enum tpm_subcaps_size {
 ///////////////////////////////////////////////////////////////////////////
 
 int TPM_Startup_Clear(unsigned char buffer[TCG_BUFFER_SIZE]);
+int TPM_ContinueSelfTest_Start(unsigned char buffer[TCG_BUFFER_SIZE]);
+int TPM_Finish(unsigned char *buffer, unsigned size);
 int TPM_Extend(unsigned char buffer[TCG_BUFFER_SIZE], unsigned long pcrindex, unsigned char *hash);
 int TPM_GetCapability_Pcrs(unsigned char buffer[TCG_BUFFER_SIZE], unsigned int *pcrs);
 int TPM_PcrRead(unsigned char buffer[TCG_BUFFER_SIZE], unsigned long pcrindex, unsigned char *pcrvalue);
@@ -0,0 +1,97 @@
+/*
+ * \brief   enums and headers for tpm2.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+#include "tpm.h"
+
+enum tpm2_constants
+  {
+    TPM2_BUFFER_SIZE   = 128,
+    TPM2_HEADER_SIZE   = 10,
+    TPM2_NOT_A_TPM2    = -3,
+    TPM_ST_NO_SESSIONS = 0x8001,
+    TPM_ST_SESSIONS    = 0x8002,
+    TPM_RS_PW          = 0x40000009,
+    TPM_SU_CLEAR       = 0x0000,
+    TPM_CAP_PCRS       = 0x00000005,
+    TPM_RC_INITIALIZE  = 0x100,
+    TPM_ALG_SHA1       = 0x0004,
+    TPM_ALG_SHA256     = 0x000b,
+    TPM2_BANK_SHA1     = 1 << 0,
+    TPM2_BANK_SHA256   = 1 << 1,
+    TPM2_BANK_OTHER    = 1 << 2,
+  };
+
+
+enum tpm2_ccs
+  {
+    TPM_CC_GetCapability = 0x17a,
+    TPM_CC_PCR_Read      = 0x17e,
+    TPM_CC_PCR_Extend    = 0x182,
+    TPM_CC_SelfTest      = 0x143,
+    TPM_CC_Startup       = 0x144,
+  };
+
+
+#ifdef CONFIG_TPM2
+/**
+ * The PCR banks of a TPM 2.0 or zero for a TPM 1.2.
+ */
+extern unsigned tpm2_banks;
+
+int tpm2_finish(unsigned char *buffer);
+int tpm2_startup_start(unsigned char *buffer);
+int tpm2_startup(unsigned char *buffer);
+int tpm2_selftest_start(unsigned char *buffer);
+int tpm2_get_banks(unsigned char *buffer);
+int tpm2_detect(unsigned char *buffer);
+int tpm2_pcr_extend(unsigned char *buffer, unsigned pcr, unsigned banks, unsigned char *sha1, unsigned char *sha256);
+int tpm2_pcr_read(unsigned char *buffer, unsigned pcrs, unsigned alg, unsigned char *values);
+int tpm_extend(unsigned char *buffer, unsigned pcr, unsigned char *sha1, unsigned char *sha256);
+#else
+/**
+ * Only a TPM 1.2 is supported, thus nothing is sent and the callers
+ * take their TPM 1.2 path.
+ */
+static const unsigned tpm2_banks = 0;
+
+static inline int tpm2_finish(unsigned char *buffer)         { (void) buffer; return TPM2_NOT_A_TPM2; }
+static inline int tpm2_startup_start(unsigned char *buffer)  { (void) buffer; return 0; }
+static inline int tpm2_selftest_start(unsigned char *buffer) { (void) buffer; return -1; }
+static inline int tpm2_detect(unsigned char *buffer)         { (void) buffer; return 0; }
+
+static inline
+int
+tpm2_pcr_extend(unsigned char *buffer, unsigned pcr, unsigned banks, unsigned char *sha1, unsigned char *sha256)
+{
+  (void) buffer; (void) pcr; (void) banks; (void) sha1; (void) sha256;
+  return -1;
+}
+
+static inline
+int
+tpm2_pcr_read(unsigned char *buffer, unsigned pcrs, unsigned alg, unsigned char *values)
+{
+  (void) buffer; (void) pcrs; (void) alg; (void) values;
+  return -1;
+}
+
+static inline
+int
+tpm_extend(unsigned char *buffer, unsigned pcr, unsigned char *sha1, unsigned char *sha256)
+{
+  (void) sha256;
+  return TPM_Extend(buffer, pcr, sha1);
+}
+#endif
@@ -0,0 +1,52 @@
+/*
+ * \brief   header of trace.c
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#pragma once
+
+enum trace_enum
+  {
+    TRACE_RECORDS     = 32,
+    TRACE_CALIBRATE_MS = 10,
+    TRACE_PMCS        = 4,
+    TRACE_PMCS_COMMON = 2,
+  };
+
+
+/**
+ * The legacy core performance counters of AMD processors and the
+ * events counted with CONFIG_TRACE_PMC.
+ */
+enum trace_pmc_enum
+  {
+    CPUID_EBX_AMD      = 0x68747541, /* "Auth" */
+    MSR_PERF_CTL0      = 0xc0010000,
+    MSR_PERF_CTR0      = 0xc0010004,
+    PERF_CTL_USR       = 1 << 16,
+    PERF_CTL_OS        = 1 << 17,
+    PERF_CTL_EN        = 1 << 22,
+    PMC_CYCLES         = 0x076,         /* CPU clocks not halted */
+    PMC_INSTRUCTIONS   = 0x0c0,         /* retired instructions */
+    PMC_L2_MISSES      = 0x07e | 0x300, /* L2 misses of IC and DC fills */
+    PMC_UNCACHED       = 0x065 | 0x100, /* requests to UC memory */
+    PMC_FAMILY_FIRST   = 0x10,          /* families with the L2 and UC events */
+    PMC_FAMILY_LAST    = 0x16,
+  };
+
+#ifdef CONFIG_TRACE
+extern unsigned trace_tpm_commands;
+void trace(const char *phase);
+void trace_dump(void);
+#else
+static inline void trace(const char *phase) { (void) phase; }
+static inline void trace_dump(void) {}
+#endif
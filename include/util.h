@@ -91,7 +91,7 @@ void out_hex(unsigned int value, unsigned int bitlen);
 /**
  * every message with out_description is prefixed with message_label
  */
-extern const char const * message_label;
+extern const char * message_label;
 void out_description(const char *prefix, unsigned int value);
 void out_info(const char *msg);
 
@@ -103,4 +103,8 @@ void wait(int ms);
 void __exit(unsigned status) __attribute__((noreturn));
 int check_cpuid(void);
 int enable_svm(void);
+#if !defined(NDEBUG) && defined(CONFIG_SERIAL)
 void serial_init(void);
+#else
+static inline void serial_init(void) {}
+#endif
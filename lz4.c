@@ -0,0 +1,132 @@
+/*
+ * \brief   A small LZ4 decompressor for the legacy frame format.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+
+#include "util.h"
+#include "lz4.h"
+
+
+/**
+ * Read a length that is continued with 255 bytes.
+ */
+static
+unsigned
+get_length(const unsigned char **src, const unsigned char *end, unsigned len)
+{
+  if (len == 15)
+    {
+      unsigned char value;
+      do
+	{
+	  value = *src < end ? *(*src)++ : 0;
+	  len += value;
+	}
+      while (value == 255);
+    }
+  return len;
+}
+
+
+/**
+ * Decompress a single LZ4 block.
+ * Returns the number of bytes written or a value < 0 on errors.
+ */
+static
+int
+lz4_block(unsigned char *dst, unsigned dst_size, const unsigned char *src, unsigned src_size)
+{
+  const unsigned char *end = src + src_size;
+  unsigned char *out = dst;
+
+  while (src < end)
+    {
+      unsigned token = *src++;
+      unsigned len = get_length(&src, end, token >> 4);
+      CHECK3(-1, len > (unsigned)(end - src) || len > dst_size - (out - dst), "lz4 literals out of range");
+      memcpy(out, src, len);
+      out += len;
+      src += len;
+
+      // the last sequence has no match
+      if (src >= end)
+	break;
+
+      CHECK3(-2, end - src < 2, "lz4 offset missing");
+      unsigned offset = src[0] | src[1] << 8;
+      src += 2;
+      len = get_length(&src, end, token & 0xf) + 4;
+      CHECK3(-3, !offset || offset > (unsigned)(out - dst), "lz4 offset invalid");
+      CHECK3(-4, len > dst_size - (out - dst), "lz4 match out of range");
+
+      // matches may overlap, thus copy bytewise
+      for (unsigned char *match = out - offset; len; len--)
+	*out++ = *match++;
+    }
+  return out - dst;
+}
+
+
+/**
+ * Decompress data in the LZ4 legacy frame format as produced by 'lz4
+ * -l' and used by linux. A trailing size field is ignored, see
+ * lz4_size().
+ *
+ * Returns the decompressed size or a value < 0 on errors.
+ */
+int
+lz4_decompress(unsigned char *dst, unsigned dst_size, const unsigned char *src, unsigned src_size)
+{
+  unsigned res = 0;
+  unsigned pos = 4;
+
+  CHECK3(-10, src_size < 4 || *(unsigned *)src != LZ4_LEGACY_MAGIC, "no lz4 legacy frame");
+  while (src_size - pos >= 4)
+    {
+      unsigned size = *(unsigned *)(src + pos);
+      pos += 4;
+
+      // concatenated frames
+      if (size == LZ4_LEGACY_MAGIC)
+	continue;
+      if (size > src_size - pos)
+	break;
+
+      int len = lz4_block(dst + res, dst_size - res, src + pos, size);
+      CHECK3(-11, len < 0, "lz4 block corrupted");
+      res += len;
+      pos += size;
+    }
+  return res;
+}
+
+
+/**
+ * Returns the decompressed size from the size field that the linux
+ * build appends to a legacy frame or 0 if there is none.
+ */
+unsigned
+lz4_size(const unsigned char *src, unsigned src_size)
+{
+  unsigned pos = 4;
+  while (src_size - pos >= 4)
+    {
+      unsigned size = *(unsigned *)(src + pos);
+      pos += 4;
+      if (size == LZ4_LEGACY_MAGIC)
+	continue;
+      if (size > src_size - pos)
+	return src_size - pos ? 0 : size;
+      pos += size;
+    }
+  return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * \brief   Physical memory allocator based on the multiboot memory map.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+
+#include "util.h"
+#include "elf.h"
+#include "mem.h"
+
+
+/**
+ * The free regions sorted by address.
+ */
+static struct region mem_regions[MEM_MAX_REGIONS];
+static unsigned mem_count;
+
+
+/**
+ * Add a free region, keeping the index sorted and merging adjacent
+ * regions. Everything is page granular and below 4G.
+ */
+static
+void
+mem_add(unsigned long long base, unsigned long long end)
+{
+  if (end > 0xfffff000ULL)
+    end = 0xfffff000ULL;
+  base = (base + MEM_PAGE_SIZE - 1) & ~(MEM_PAGE_SIZE - 1ULL);
+  end &= ~(MEM_PAGE_SIZE - 1ULL);
+  if (base >= end)
+    return;
+
+  unsigned i;
+  for (i=0; i < mem_count && mem_regions[i].end < base; i++)
+    ;
+  if (i < mem_count && mem_regions[i].base <= end)
+    {
+      // overlapping or adjacent - merge with the following ones
+      if (base < mem_regions[i].base)
+	mem_regions[i].base = base;
+      if (end > mem_regions[i].end)
+	mem_regions[i].end = end;
+      while (i+1 < mem_count && mem_regions[i+1].base <= mem_regions[i].end)
+	{
+	  if (mem_regions[i+1].end > mem_regions[i].end)
+	    mem_regions[i].end = mem_regions[i+1].end;
+	  mem_count--;
+	  for (unsigned j=i+1; j < mem_count; j++)
+	    mem_regions[j] = mem_regions[j+1];
+	}
+      return;
+    }
+
+  CHECK3(, mem_count >= MEM_MAX_REGIONS, "too many memory regions");
+  for (unsigned j=mem_count; j > i; j--)
+    mem_regions[j] = mem_regions[j-1];
+  mem_regions[i].base = base;
+  mem_regions[i].end  = end;
+  mem_count++;
+}
+
+
+/**
+ * Remove a range from the free regions. The range is extended to
+ * page boundaries.
+ */
+void
+mem_reserve(unsigned base, unsigned size)
+{
+  unsigned long long end = ((unsigned long long) base + size + MEM_PAGE_SIZE - 1) & ~(MEM_PAGE_SIZE - 1ULL);
+  base &= ~(MEM_PAGE_SIZE - 1);
+
+  for (unsigned i=0; i < mem_count; i++)
+    {
+      struct region *r = mem_regions + i;
+      if (r->end <= base || r->base >= end)
+	continue;
+
+      if (r->base < base && r->end > end)
+	{
+	  // split the region
+	  unsigned old = r->end;
+	  r->end = base;
+	  mem_add(end, old);
+	  return;
+	}
+      if (r->base < base)
+	r->end = base;
+      else if (r->end > end)
+	r->base = end;
+      else
+	{
+	  mem_count--;
+	  for (unsigned j=i; j < mem_count; j++)
+	    mem_regions[j] = mem_regions[j+1];
+	  i--;
+	}
+    }
+}
+
+
+/**
+ * Reserve a zero terminated string.
+ */
+static
+void
+mem_reserve_string(unsigned s)
+{
+  if (s)
+    mem_reserve(s, strlen((char *) s) + 1);
+}
+
+
+/**
+ * Build the free region index from the multiboot memory map. The
+ * first page, the trampoline, the loader image, the MBI and
+ * everything it references like modules and strings are excluded.
+ */
+int
+mem_init(struct mbi *mbi)
+{
+  mem_count = 0;
+  if (mbi->flags & MBI_FLAG_MMAP)
+    for (unsigned i = mbi->mmap_addr; i < mbi->mmap_addr + mbi->mmap_length; i += ((struct mmap *)i)->size + 4)
+      {
+	struct mmap *mmap = (struct mmap *)i;
+	if (mmap->type == MEM_TYPE_RAM)
+	  mem_add(mmap->base, mmap->base + mmap->length);
+      }
+  else if (mbi->flags & MBI_FLAG_MEM)
+    {
+      mem_add(0, mbi->mem_lower << 10);
+      mem_add(1 << 20, (1 << 20) + ((unsigned long long) mbi->mem_upper << 10));
+    }
+  CHECK3(-1, !mem_count, "no memory map");
+
+  mem_reserve(0, MEM_PAGE_SIZE);
+  mem_reserve(TRAMPOLINE_ADDRESS, MEM_PAGE_SIZE);
+  mem_reserve((unsigned) &__IMAGE_START__, &__IMAGE_END__ - &__IMAGE_START__);
+  mem_reserve((unsigned) mbi, sizeof(*mbi));
+  if (mbi->flags & MBI_FLAG_CMDLINE)
+    mem_reserve_string(mbi->cmdline);
+  if (mbi->flags & MBI_FLAG_BOOT_LOADER_NAME)
+    mem_reserve_string(mbi->boot_loader_name);
+  if (mbi->flags & MBI_FLAG_MMAP)
+    mem_reserve(mbi->mmap_addr, mbi->mmap_length);
+  if (mbi->flags & MBI_FLAG_MODS)
+    {
+      struct module *m = (struct module *) mbi->mods_addr;
+      mem_reserve(mbi->mods_addr, mbi->mods_count * sizeof(*m));
+      for (unsigned i=0; i < mbi->mods_count; i++, m++)
+	{
+	  mem_reserve(m->mod_start, m->mod_end - m->mod_start);
+	  mem_reserve_string(m->string);
+	}
+    }
+  return 0;
+}
+
+
+/**
+ * Allocate size bytes of page aligned memory that ends below limit,
+ * where a limit of 0 means 4G. We allocate from the top, so that low
+ * memory is left for the ones that need it.
+ *
+ * Returns the address or 0 if nothing fits.
+ */
+unsigned
+mem_alloc(unsigned size, unsigned limit)
+{
+  size = (size + MEM_PAGE_SIZE - 1) & ~(MEM_PAGE_SIZE - 1);
+  limit &= ~(MEM_PAGE_SIZE - 1);
+  if (!limit)
+    limit = ~(MEM_PAGE_SIZE - 1);
+  for (unsigned i=mem_count; i--; )
+    {
+      unsigned end = mem_regions[i].end < limit ? mem_regions[i].end : limit;
+      if (end <= mem_regions[i].base || end - mem_regions[i].base < size)
+	continue;
+      mem_reserve(end - size, size);
+      return end - size;
+    }
+  out_description("could not allocate", size);
+  return 0;
+}
+
+
+/**
+ * Append an entry to a multiboot memory map.
+ */
+static
+struct mmap *
+mem_mmap_add(struct mmap *mmap, unsigned long long base, unsigned long long end, unsigned type)
+{
+  if (base >= end)
+    return mmap;
+  mmap->size = sizeof(*mmap) - 4;
+  mmap->base = base;
+  mmap->length = end - base;
+  mmap->type = type;
+  return mmap + 1;
+}
+
+
+/**
+ * Mark a range as reserved in the memory map handed to the next
+ * module. The map is copied, as it could be in use by the loader.
+ */
+int
+mem_mmap_reserve(struct mbi *mbi, unsigned base, unsigned size)
+{
+  CHECK3(-1, !(mbi->flags & MBI_FLAG_MMAP), "no memory map");
+  unsigned length = 0;
+  for (unsigned i = mbi->mmap_addr; i < mbi->mmap_addr + mbi->mmap_length; i += ((struct mmap *)i)->size + 4)
+    length += 3 * sizeof(struct mmap);
+
+  struct mmap *start;
+  CHECK3(-2, !(start = (struct mmap *) mem_alloc(length, 0)), "no memory for the memory map");
+
+  unsigned long long end = (unsigned long long) base + size;
+  struct mmap *mmap = start;
+  for (unsigned i = mbi->mmap_addr; i < mbi->mmap_addr + mbi->mmap_length; i += ((struct mmap *)i)->size + 4)
+    {
+      struct mmap *old = (struct mmap *)i;
+      unsigned long long old_end = old->base + old->length;
+      if (old->type != MEM_TYPE_RAM || old_end <= base || old->base >= end)
+	mmap = mem_mmap_add(mmap, old->base, old_end, old->type);
+      else
+	{
+	  mmap = mem_mmap_add(mmap, old->base, base, old->type);
+	  mmap = mem_mmap_add(mmap, old->base > base ? old->base : base, old_end < end ? old_end : end, MEM_TYPE_RESERVED);
+	  mmap = mem_mmap_add(mmap, end, old_end, old->type);
+	}
+    }
+  mbi->mmap_addr = (unsigned) start;
+  mbi->mmap_length = (char *) mmap - (char *) start;
+  return 0;
+}
+
+
+#ifndef NDEBUG
+/**
+ * Print the free regions.
+ */
+void
+mem_dump(void)
+{
+  for (unsigned i=0; i < mem_count; i++)
+    {
+      out_string(message_label);
+      out_string("free ");
+      out_hex(mem_regions[i].base, 31);
+      out_char('-');
+      out_hex(mem_regions[i].end, 31);
+      out_char('\n');
+    }
+}
+#endif
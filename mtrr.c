@@ -0,0 +1,216 @@
+/*
+ * \brief   MTRR handling to hash and copy modules with write-back caching.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+
+#include "util.h"
+#include "mtrr.h"
+
+#ifdef CONFIG_MTRR
+
+
+/**
+ * The variable MTRRs we have changed and their original masks. The
+ * original base registers are restored from mtrr_saved_base.
+ */
+static unsigned mtrr_changed;
+static unsigned long long mtrr_saved_base[MTRR_MAX_VAR];
+static unsigned long long mtrr_saved_mask[MTRR_MAX_VAR];
+
+
+/**
+ * Returns the mask for all physical address bits above 4k.
+ */
+static
+unsigned long long
+mtrr_phys_mask(void)
+{
+  unsigned bits = 36;
+  if (cpuid_eax(0x80000000) >= 0x80000008)
+    bits = cpuid_eax(0x80000008) & 0xff;
+  return ((1ULL << bits) - 1) & ~0xfffULL;
+}
+
+
+/**
+ * Get the range [start, end) covered by a valid variable MTRR.
+ * Returns the type or -1 if the MTRR is not used.
+ */
+static
+int
+mtrr_var(unsigned i, unsigned long long *start, unsigned long long *end)
+{
+  unsigned long long mask = rdmsr(MSR_MTRR_BASE + 2*i + 1);
+  if (!(mask & MTRR_MASK_VALID))
+    return -1;
+  unsigned long long base = rdmsr(MSR_MTRR_BASE + 2*i);
+  *start = base & mtrr_phys_mask();
+  *end   = *start + (~mask & mtrr_phys_mask()) + 0x1000;
+  return base & 0xff;
+}
+
+
+/**
+ * Returns the type of a fixed MTRR for an address below 1M.
+ */
+static
+unsigned
+mtrr_fixed_type(unsigned addr)
+{
+  unsigned long long value;
+  if (addr < 0x80000)
+    value = rdmsr(MSR_MTRR_FIX_64K) >> (addr >> 16)*8;
+  else if (addr < 0xc0000)
+    value = rdmsr(MSR_MTRR_FIX_16K + ((addr - 0x80000) >> 17)) >> ((addr >> 14) & 7)*8;
+  else
+    value = rdmsr(MSR_MTRR_FIX_4K + ((addr - 0xc0000) >> 15)) >> ((addr >> 12) & 7)*8;
+  return value & 0xff;
+}
+
+
+/**
+ * Returns the effective cache type of a range. The UC type wins over
+ * all others and WT wins over WB. Parts not covered by a variable
+ * MTRR have the default type.
+ */
+unsigned
+mtrr_type(unsigned long long base, unsigned long long size)
+{
+  unsigned long long def = rdmsr(MSR_MTRR_DEF_TYPE);
+  if (!(def & MTRR_DEF_E))
+    return MTRR_UC;
+  if (base < (1 << 20) && def & MTRR_DEF_FE)
+    return mtrr_fixed_type(base);
+
+  unsigned long long end = base + size;
+  unsigned long long pos = base;
+  int res = -1;
+  unsigned count = rdmsr(MSR_MTRR_CAP) & MTRR_CAP_VCNT;
+  for (unsigned i=0; i < count; i++)
+    {
+      unsigned long long start, stop;
+      int type = mtrr_var(i, &start, &stop);
+      if (type < 0 || stop <= base || start >= end)
+	continue;
+      if (res < 0 || type == MTRR_UC || (type == MTRR_WT && res == MTRR_WB))
+	res = type;
+    }
+
+  // is the range completely covered by variable MTRRs?
+  for (unsigned i=0; i < count && pos < end; i++)
+    {
+      unsigned long long start, stop;
+      if (mtrr_var(i, &start, &stop) >= 0 && start <= pos && stop > pos)
+	{
+	  pos = stop;
+	  i = -1;
+	}
+    }
+  if (res < 0 || (pos < end && res != MTRR_UC && (def & 0xff) != MTRR_WB))
+    res = def & 0xff;
+  return res;
+}
+
+
+/**
+ * Change MTRRs as described in the Intel SDM Vol. 3 11.11.7.2.
+ */
+static
+void
+mtrr_write(unsigned i, unsigned long long base, unsigned long long mask)
+{
+  unsigned cr0 = read_cr0();
+  write_cr0((cr0 | CR0_CD) & ~CR0_NW);
+  wbinvd();
+  unsigned long long def = rdmsr(MSR_MTRR_DEF_TYPE);
+  wrmsr(MSR_MTRR_DEF_TYPE, def & ~MTRR_DEF_E);
+  wrmsr(MSR_MTRR_BASE + 2*i, base);
+  wrmsr(MSR_MTRR_BASE + 2*i + 1, mask);
+  wbinvd();
+  wrmsr(MSR_MTRR_DEF_TYPE, def);
+  write_cr0(cr0);
+}
+
+
+/**
+ * Make a range write-back cacheable by using free variable MTRRs for
+ * the parts not already covered by a WB MTRR. Ranges overlapping
+ * other variable MTRRs are not touched, as these could describe MMIO
+ * regions.
+ *
+ * Returns the original cache type of the range.
+ */
+int
+mtrr_set_wb(unsigned base, unsigned size)
+{
+  CHECK3(-1, !(cpuid_edx(1) & CPUID_EDX_MTRR), "no MTRR support");
+  unsigned type = mtrr_type(base, size);
+  out_description("cache type", type);
+  if (type == MTRR_WB)
+    return type;
+  CHECK3(type, type != (rdmsr(MSR_MTRR_DEF_TYPE) & 0xff), "conflicting MTRR");
+
+  unsigned long long pos = base & ~0xfff;
+  unsigned long long end = ((unsigned long long) base + size + 0xfff) & ~0xfffULL;
+  unsigned count = rdmsr(MSR_MTRR_CAP) & MTRR_CAP_VCNT;
+  for (unsigned i=0; i < count && i < MTRR_MAX_VAR && pos < end; i++)
+    {
+      unsigned long long start, stop;
+      if (mtrr_var(i, &start, &stop) >= 0)
+	continue;
+
+      // the largest naturally aligned block at pos that fits into the range
+      unsigned long long block = pos ? pos & -pos : 1ULL << 32;
+      while (pos + block > end)
+	block >>= 1;
+
+      mtrr_saved_base[i] = rdmsr(MSR_MTRR_BASE + 2*i);
+      mtrr_saved_mask[i] = rdmsr(MSR_MTRR_BASE + 2*i + 1);
+      mtrr_changed |= 1 << i;
+      mtrr_write(i, pos | MTRR_WB, (~(block - 1) & mtrr_phys_mask()) | MTRR_MASK_VALID);
+      pos += block;
+    }
+  CHECK3(type, pos < end, "out of variable MTRRs");
+  return type;
+}
+
+
+/**
+ * Returns the original value of a variable MTRR changed by
+ * mtrr_set_wb() and forgets the change, so that the caller restores
+ * it later.  Returns 0 if the MTRR was not changed.
+ */
+int
+mtrr_saved(unsigned i, unsigned long long *base, unsigned long long *mask)
+{
+  if (i >= MTRR_MAX_VAR || !(mtrr_changed & (1 << i)))
+    return 0;
+  *base = mtrr_saved_base[i];
+  *mask = mtrr_saved_mask[i];
+  mtrr_changed &= ~(1 << i);
+  return 1;
+}
+
+
+/**
+ * Restore the MTRRs changed by mtrr_set_wb().
+ */
+void
+mtrr_restore(void)
+{
+  for (unsigned i=0; i < MTRR_MAX_VAR; i++)
+    if (mtrr_changed & (1 << i))
+      mtrr_write(i, mtrr_saved_base[i], mtrr_saved_mask[i]);
+  mtrr_changed = 0;
+}
+
+#endif
@@ -15,79 +15,377 @@
 #include "version.h"
 #include "util.h"
 #include "munich.h"
+#include "elf.h"
+#include "lz4.h"
+#include "mem.h"
+#include "mtrr.h"
+#include "dev.h"
 #include "boot_linux.h"
+#include "stage.h"
+#include "tcglog.h"
+#include "trace.h"
 
+#ifndef STAGED
 const char *message_label = "MUNICH: ";
+#endif
+
+const unsigned LINUX_LOWMEM_LIMIT = 0xa0000;
+
+
+/**
+ * Fill the e820 map of the boot_params from the multiboot memory
+ * map. Falls back to mem_lower and mem_upper if no mmap is available.
+ */
+static
+void
+fill_e820_map(struct mbi *mbi, struct boot_params *params)
+{
+  struct e820entry *e = params->e820_map;
+  if (mbi->flags & MBI_FLAG_MMAP)
+    for (unsigned i = mbi->mmap_addr;
+	 i < mbi->mmap_addr + mbi->mmap_length && e < params->e820_map + LINUX_E820_MAX;
+	 i += ((struct mmap *)i)->size + 4, e++)
+      {
+	struct mmap *mmap = (struct mmap *)i;
+	e->addr = mmap->base;
+	e->size = mmap->length;
+	e->type = mmap->type;
+      }
+  else if (mbi->flags & MBI_FLAG_MEM)
+    {
+      e->addr = 0;
+      e->size = mbi->mem_lower << 10;
+      e->type = 1;
+      e++;
+      e->addr = 1 << 20;
+      e->size = (unsigned long long) mbi->mem_upper << 10;
+      e->type = 1;
+      e++;
+    }
+  params->e820_entries = e - params->e820_map;
+  out_description("e820 entries", params->e820_entries);
+
+  if (mbi->flags & MBI_FLAG_MEM)
+    {
+      params->alt_mem_k = mbi->mem_upper;
+      params->ext_mem_k = mbi->mem_upper < 0xfc00 ? mbi->mem_upper : 0xfc00;
+    }
+}
+
 
-const unsigned REALMODE_STACK = 0x49000;
-const unsigned REALMODE_IMAGE = 0x40000;
+/**
+ * Decompress an LZ4 compressed kernel into freshly allocated memory.
+ */
+static
+void
+decompress_kernel(struct module *kernel)
+{
+  unsigned char *src = (unsigned char *) kernel->mod_start;
+  unsigned src_size = kernel->mod_end - kernel->mod_start;
+  unsigned size = lz4_size(src, src_size);
+  unsigned dst;
+
+  ERROR(-20, !size, "decompressed size unknown");
+  ERROR(-21, !(dst = mem_alloc(size, 0)), "no memory to decompress");
+  out_description("decompress kernel to", dst);
+  ERROR(-22, lz4_decompress((unsigned char *) dst, size, src, src_size) != (int) size, "decompression failed");
+  kernel->mod_start = dst;
+  kernel->mod_end   = dst + size;
+}
+
+
+/**
+ * Exclude the destination of the kernel from the allocator. A
+ * bzImage decompresses itself in place and needs init_size bytes
+ * there.
+ *
+ * Returns the range covered by the kernel.
+ */
+static
+struct region
+reserve_kernel(struct module *kernel, unsigned elf, struct linux_kernel_header *hdr)
+{
+  struct region range;
+  if (!elf)
+    {
+      unsigned size = hdr->syssize*16;
+      if (hdr->version >= LINUX_INIT_SIZE_VERSION && hdr->init_size > size)
+	size = hdr->init_size;
+      mem_reserve(hdr->code32_start, size);
+      range.base = hdr->code32_start;
+      range.end  = hdr->code32_start + size;
+      return range;
+    }
+
+  range.base = ~0u;
+  range.end  = 0;
+  struct eh *eh = (struct eh *) kernel->mod_start;
+  for (unsigned i=0; i < eh->e_phnum; i++)
+    {
+      struct ph *ph = (struct ph *)(kernel->mod_start + eh->e_phoff + i*eh->e_phentsize);
+      if (ph->p_type != 1)
+	continue;
+      mem_reserve((unsigned) ph->p_paddr, ph->p_memsz);
+      if ((unsigned) ph->p_paddr < range.base)
+	range.base = (unsigned) ph->p_paddr;
+      if ((unsigned) ph->p_paddr + ph->p_memsz > range.end)
+	range.end = (unsigned) ph->p_paddr + ph->p_memsz;
+    }
+  return range;
+}
+
+
+/**
+ * The decompressed kernel was allocated before its destination was
+ * known and reserved.  Move it out of the way if it lies there, as it
+ * would be overwritten while it is copied.
+ */
+static
+void
+move_kernel(struct module *kernel, struct region *range)
+{
+  unsigned size = kernel->mod_end - kernel->mod_start;
+  unsigned dst;
+
+  if (kernel->mod_start >= range->end || kernel->mod_end <= range->base)
+    return;
+  ERROR(-28, !(dst = mem_alloc(size, 0)), "no memory to move the kernel");
+  out_description("move kernel to", dst);
+  memcpy((char *) dst, (char *) kernel->mod_start, size);
+  kernel->mod_start = dst;
+  kernel->mod_end   = dst + size;
+}
+
+
+/**
+ * Returns the size of the real-mode part of a bzImage.
+ */
+static inline
+unsigned
+setup_size(struct linux_kernel_header *hdr)
+{
+  return ((hdr->setup_sects ? hdr->setup_sects : 4) + 1) << 9;
+}
+
+
+/**
+ * Fill the setup header from a bzImage.
+ */
+static
+void
+load_bzimage(struct module *m, struct boot_params *params)
+{
+  struct linux_kernel_header *hdr = (struct linux_kernel_header *)(m->mod_start + 0x1f1);
+
+  ERROR(-14, LINUX_BOOT_FLAG_MAGIC != hdr->boot_flag, "boot flag does not match");
+  ERROR(-15, LINUX_HEADER_MAGIC != hdr->header, "too old linux version?");
+  ERROR(-16, 0x203 > hdr->version, "can not start linux pre 2.4.18");
+  ERROR(-17, !(hdr->loadflags & LINUX_LOADED_HIGH), "not a bzImage?");
+
+  // output kernel version string
+  if (hdr->kernel_version)
+    {
+      ERROR(-18, hdr->setup_sects << 9 < hdr->kernel_version, "version pointer invalid");
+      out_info((char *)(m->mod_start + hdr->kernel_version + 0x200));
+    }
+
+  // the zero page starts with the setup header of the kernel
+  memcpy(&params->hdr, hdr, 0x202 + (hdr->jump >> 8) - 0x1f1);
+}
+
+
+/**
+ * Fill the setup header for a vmlinux that has none.
+ */
+static
+void
+init_vmlinux_header(struct boot_params *params)
+{
+  struct linux_kernel_header *hdr = &params->hdr;
+
+  out_info("vmlinux ELF image");
+  hdr->boot_flag       = LINUX_BOOT_FLAG_MAGIC;
+  hdr->header          = LINUX_HEADER_MAGIC;
+  hdr->version         = LINUX_SETUP_DATA_VERSION;
+  hdr->loadflags       = LINUX_LOADED_HIGH;
+  hdr->initrd_addr_max = LINUX_INITRD_ADDR_MAX;
+}
+
+
+/**
+ * Pass the hand-off module that OSLO appends as last module via
+ * setup_data instead of the initrd.
+ */
+static
+void
+load_handoff(struct mbi *mbi, struct linux_kernel_header *hdr)
+{
+  struct module *m = (struct module *) (mbi->mods_addr) + mbi->mods_count - 1;
+  const char *name = OSLO_HANDOFF_NAME;
+  char *s = (char *) m->string;
+  if (mbi->mods_count < 2)
+    return;
+  while (*name && *name == *s)
+    name++, s++;
+  if (*name || (*s && *s != ' '))
+    return;
+
+  mbi->mods_count--;
+  CHECK3(, hdr->version < LINUX_SETUP_DATA_VERSION, "no setup_data support, drop the hand-off");
+
+  unsigned len = m->mod_end - m->mod_start;
+  struct setup_data *data;
+  ERROR(-25, !(data = (struct setup_data *) mem_alloc(sizeof(*data) + len, 0)), "no memory for setup_data");
+  data->next = hdr->setup_data;
+  data->type = LINUX_SETUP_OSLO;
+  data->len  = len;
+  memcpy(data + 1, (char *) m->mod_start, len);
+  hdr->setup_data = (unsigned) data;
+  out_description("hand-off", (unsigned) data);
+}
+
+
+/**
+ * Place all modules after the kernel contiguously below
+ * initrd_addr_max, so that linux sees them as a single initrd. Every
+ * module starts 4-byte aligned as needed for concatenated cpio
+ * archives. Modules that are already at the right place are not
+ * copied, unless the kernel is loaded over them.
+ */
+static
+void
+load_initrds(struct mbi *mbi, struct linux_kernel_header *hdr, struct region *kernel)
+{
+  struct module *m  = (struct module *) (mbi->mods_addr) + 1;
+  unsigned count = mbi->mods_count - 1;
+  if (!count)
+    return;
+
+  // keep the modules in place if they are already contiguous
+  unsigned start = m->mod_start;
+  unsigned size = 0;
+  unsigned contiguous = !(start & 3);
+  for (unsigned i=0; i < count; i++)
+    {
+      ERROR(-19, m[i].mod_end < m[i].mod_start, "mod_end less than start");
+      size = (size + 3) & ~3;
+      contiguous &= m[i].mod_start == start + size;
+      size += m[i].mod_end - m[i].mod_start;
+    }
+  if (!contiguous || start + size - 1 > hdr->initrd_addr_max
+      || (start < kernel->end && start + size > kernel->base))
+    {
+      ERROR(-23, !(start = mem_alloc(size, hdr->initrd_addr_max + 1)), "no memory for the initrd");
+      out_description("relocating initrd", start);
+    }
+
+  // a single copy pass - either nothing is copied or the allocator
+  // guarantees that we do not overwrite other modules or the kernel
+  unsigned dst = start;
+  for (unsigned i=0; i < count; i++)
+    {
+      unsigned len = m[i].mod_end - m[i].mod_start;
+      memset((char *) dst, 0, -dst & 3);
+      dst = (dst + 3) & ~3;
+      if (dst != m[i].mod_start)
+	memcpy((char *) dst, (char *) m[i].mod_start, len);
+      dst += len;
+    }
+
+  hdr->ramdisk_image = start;
+  hdr->ramdisk_size  = size;
+  out_description("initrd", start);
+  out_description("initrd size", size);
+}
 
 
 /**
  * Starts a linux from multiboot modules. Treats the first module as
- * linux kernel and the optional second module as initrd.
+ * linux kernel and all following modules as initrd.
+ *
+ * The kernel is either a bzImage or an uncompressed vmlinux ELF
+ * image, which could be additionally LZ4 compressed. We build the
+ * boot_params ourself and use the 32-bit boot protocol, thus the
+ * real-mode setup code of the kernel and its BIOS calls are skipped.
+ * Expects an initialized memory allocator.
  */
 int
 start_linux(struct mbi *mbi)
 {
   struct module *m  = (struct module *) (mbi->mods_addr);
-  struct linux_kernel_header *hdr = (struct linux_kernel_header *)(m->mod_start + 0x1f1);
+  struct boot_params *params;
 
+  trace("linux");
   // sanity checks
   ERROR(-11, ~mbi->flags & MBI_FLAG_MODS, "module flag missing");
   ERROR(-12, !mbi->mods_count, "no kernel to start");
-  ERROR(-13, 2 < mbi->mods_count, "do not know what to do with that many modules");
-  ERROR(-14, LINUX_BOOT_FLAG_MAGIC != hdr->boot_flag, "boot flag does not match");
-  ERROR(-15, LINUX_HEADER_MAGIC != hdr->header, "too old linux version?");
-  ERROR(-16, 0x202 > hdr->version, "can not start linux pre 2.4.0");
-  ERROR(-17, !(hdr->loadflags & 0x01), "not a bzImage?");
+
+  // copying is slow if the modules are not cached
+  for (unsigned i=0; i < mbi->mods_count; i++)
+    mtrr_set_wb(m[i].mod_start, m[i].mod_end - m[i].mod_start);
+
+  struct module kernel = *m;
+  if (*(unsigned *) kernel.mod_start == LZ4_LEGACY_MAGIC)
+    decompress_kernel(&kernel);
+
+  ERROR(-26, !(params = (struct boot_params *) mem_alloc(sizeof(*params), LINUX_LOWMEM_LIMIT)), "no memory for boot_params");
+  struct linux_kernel_header *hdr = &params->hdr;
+  memset(params, 0, sizeof(*params));
+  unsigned elf = *(unsigned *) kernel.mod_start == ELF_MAGIC;
+  if (elf)
+    init_vmlinux_header(params);
+  else
+    load_bzimage(&kernel, params);
+  struct region range = reserve_kernel(&kernel, elf, hdr);
+  if (kernel.mod_start != m->mod_start)
+    move_kernel(&kernel, &range);
 
   // filling out the header
   hdr->type_of_loader = 0x7;      // fake GRUB here
-  hdr->cmd_line_ptr   = REALMODE_STACK;
 
-  // enable heap
-  hdr->heap_end_ptr   = (REALMODE_STACK - 0x200) & 0xffff;
-  hdr->loadflags     |= 0x80;
+  // we do not run the setup code, thus describe the VGA console ourself
+  params->orig_video_mode   = 3;
+  params->orig_video_cols   = 80;
+  params->orig_video_lines  = 25;
+  params->orig_video_isVGA  = 1;
+  params->orig_video_points = 16;
 
-  // output kernel version string
-  if (hdr->kernel_version)
-    {
-      ERROR(-18, hdr->setup_sects << 9 < hdr->kernel_version, "version pointer invalid");
-      out_info((char *)(m->mod_start + hdr->kernel_version + 0x200));
-    }
+  fill_e820_map(mbi, params);
 
   //fix cmdline
   char *cmdline = (char *) m->string;
   while (*cmdline && *cmdline++ !=' ')
     ;
   out_info(cmdline);
+  ERROR(-24, !(hdr->cmd_line_ptr = mem_alloc(strlen(cmdline)+1, LINUX_LOWMEM_LIMIT)), "no memory for the cmdline");
+  memcpy((char *) hdr->cmd_line_ptr, cmdline, strlen(cmdline)+1);
 
-  // handle initrd
-  if (1 < mbi->mods_count)
+  load_handoff(mbi, hdr);
+  trace("initrd");
+  load_initrds(mbi, hdr, &range);
+
+  if (!elf)
     {
-      hdr->ramdisk_size = (m+1)->mod_end - (m+1)->mod_start;
-      hdr->ramdisk_image = (m+1)->mod_start;
-      if (hdr->ramdisk_image + hdr->ramdisk_size > hdr->initrd_addr_max)
-	{
-	  unsigned long dst = (hdr->initrd_addr_max - hdr->ramdisk_size + 0xfff) & ~0xfff;
-	  out_description("relocating initrd", dst);
-	  memcpy((char *)dst, (char *)hdr->ramdisk_image, hdr->ramdisk_size);
-	  hdr->ramdisk_image = dst;
-	}
-      out_description("initrd",  hdr->ramdisk_image);
+      trace("copy");
+      out_info("copy image");
+      memcpy((char *) hdr->code32_start, (char *) kernel.mod_start + setup_size(hdr), hdr->syssize*16);
     }
 
-  out_info("copy image");
-  memcpy((char *) REALMODE_IMAGE, (char *) m->mod_start, (hdr->setup_sects+1) << 9);
-  memcpy((char *) hdr->cmd_line_ptr, cmdline, strlen(cmdline)+1);
-  memcpy((char *) hdr->code32_start, (char *)  m->mod_start + ((hdr->setup_sects+1) << 9), hdr->syssize*16);
+  // linux does not know about the DEV
+  if (dev_enabled())
+    ERROR(-27, disable_dev_protection(), "DEV disable failed");
 
   out_info("start kernel");
-  jmp_kernel(REALMODE_IMAGE / 16 + 0x20, REALMODE_STACK);
+  trace("start");
+  trace_dump();
+  if (elf)
+    start_elf(&kernel, jmp_kernel32, (unsigned) params);
+  mtrr_restore();
+  jmp_kernel32(hdr->code32_start, params);
 }
 
 
+#ifndef STAGED
 /**
  * Start a linux from a multiboot structure.
  */
@@ -97,8 +395,12 @@ __main(struct mbi *mbi, unsigned flags)
 #ifndef NDEBUG
   serial_init();
 #endif
+  trace("main");
   out_info(VERSION " starts Linux");
   ERROR(10, !mbi || flags != MBI_MAGIC, "Not loaded via multiboot");
+  trace("mem");
+  ERROR(13, mem_init(mbi), "no free memory");
   ERROR(11, start_linux(mbi), "start linux failed");
   return 12;
 }
+#endif
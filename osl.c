@@ -16,14 +16,30 @@
 #include "version.h"
 #include "util.h"
 #include "sha.h"
+#include "sha256.h"
 #include "elf.h"
 #include "tpm.h"
+#include "tpm2.h"
 #include "mp.h"
+#include "mtrr.h"
+#include "mem.h"
+#include "tcglog.h"
+#include "trace.h"
 #include "osl.h"
 
 static const char *version_string = "OSLO " VERSION "\n";
 const char * message_label = "OSLO:   ";
 
+#ifdef CONFIG_DRYRUN
+/**
+ * The PCR of the modules.  PCR19 can be extended only from locality 2
+ * and 3, thus a dry run in locality 0 uses the debug PCR23.
+ */
+static unsigned modules_pcr = 19;
+#else
+enum { modules_pcr = 19 };
+#endif
+
 /**
  * Function to output a hash.
  */
@@ -38,12 +54,32 @@ show_hash(char *s, unsigned char *hash)
 }
 
 
+/**
+ * Hash a memory region with SHA1 and, if the TPM has such a bank,
+ * with SHA-256.
+ */
+static
+void
+hash_region(struct Context *ctx, struct Sha256Context *ctx256, unsigned char *start, unsigned size)
+{
+  sha1_init(ctx);
+  sha1(ctx, start, size);
+  sha1_finish(ctx);
+  if (tpm2_banks & TPM2_BANK_SHA256)
+    {
+      sha256_init(ctx256);
+      sha256(ctx256, start, size);
+      sha256_finish(ctx256);
+    }
+}
+
+
 /**
  *  Hash all multiboot modules.
  */
 static
 int
-mbi_calc_hash(struct mbi *mbi, struct Context *ctx)
+mbi_calc_hash(struct mbi *mbi, unsigned char *buffer, struct Context *ctx, struct Sha256Context *ctx256)
 {
   unsigned res;
 
@@ -54,36 +90,134 @@ mbi_calc_hash(struct mbi *mbi, struct Context *ctx)
   struct module *m  = (struct module *) (mbi->mods_addr);
   for (unsigned i=0; i < mbi->mods_count; i++, m++)
     {
-      sha1_init(ctx);
       CHECK3(-13, m->mod_end < m->mod_start, "mod_end less than start");
-      sha1(ctx, (unsigned char*) m->mod_start, m->mod_end - m->mod_start);
-      sha1_finish(ctx);
-      CHECK4(-14, (res = TPM_Extend(ctx->buffer, 19, ctx->hash)), "TPM extend failed", res);
+      mtrr_set_wb(m->mod_start, m->mod_end - m->mod_start);
+      hash_region(ctx, ctx256, (unsigned char*) m->mod_start, m->mod_end - m->mod_start);
+      tcglog_module(modules_pcr, i, m, ctx->hash, ctx256->hash);
+      CHECK4(-14, (res = tpm_extend(buffer, modules_pcr, ctx->hash, ctx256->hash)), "TPM extend failed", res);
     }
   return 0;
 }
 
 
 /**
- * Prepare the TPM for skinit.
+ * Log the two PCR17 measurements: the SLB by skinit and the rest of
+ * OSLO by the stub.  Both already extended all banks.
+ */
+static
+void
+log_oslo(struct Context *ctx, struct Sha256Context *ctx256)
+{
+  hash_region(ctx, ctx256, (unsigned char *) &__LOADER_START__, &__LOADER_END__ - &__LOADER_START__);
+  tcglog_event(17, EV_IPL, ctx->hash, ctx256->hash, "OSLO SLB", 9);
+
+  hash_region(ctx, ctx256, (unsigned char *) &__LOADER_END__, &__OSLO_END__ - &__LOADER_END__);
+  tcglog_event(17, EV_IPL, ctx->hash, ctx256->hash, "OSLO", 5);
+}
+
+
+/**
+ * Read the final PCR17 and module PCR values of the SHA1 bank, with
+ * a single command on a TPM 2.0.
+ */
+static
+int
+read_pcrs(unsigned char *buffer, unsigned char *pcrs)
+{
+  int res;
+  if (tpm2_banks)
+    return (res = tpm2_pcr_read(buffer, 1 << 17 | 1 << modules_pcr, TPM_ALG_SHA1, pcrs)) == 2 ? 0 : -1;
+  if ((res = TPM_PcrRead(buffer, 17, pcrs)))
+    return res;
+  return TPM_PcrRead(buffer, modules_pcr, pcrs + 20);
+}
+
+
+/**
+ * Start the TPM for skinit.  The result of the TPM2_Startup is not
+ * waited for, so that the CPU can be checked in the meantime.
  * Returns a TIS_INIT_* value.
  */
 static
 int
-prepare_tpm(unsigned char *buffer)
+start_tpm(unsigned char *buffer)
 {
-  int tpm, res;
+  int tpm;
 
+  trace("tpm");
   CHECK4(-60, 0 >= (tpm = tis_init(TIS_BASE)), "tis init failed", tpm);
   CHECK3(-61, !tis_access(TIS_LOCALITY_0, 0), "could not gain TIS ownership");
-  if ((res=TPM_Startup_Clear(buffer)) && res!=0x26)
+  CHECK3(-62, tpm2_startup_start(buffer) < 0, "could not start the TPM");
+  return tpm;
+}
+
+
+/**
+ * Collect the startup result and start the self test, which runs
+ * while SVM is enabled and the APs are stopped.  Otherwise the first
+ * extend after skinit would wait for it.
+ */
+static
+int
+selftest_tpm(unsigned char *buffer, int *tpm2)
+{
+  int res;
+
+  trace("selftest");
+  // a TPM 1.2 does not understand the TPM2 command
+  *tpm2 = (res = tpm2_finish(buffer)) != TPM2_NOT_A_TPM2;
+  if (!*tpm2)
+    res = TPM_Startup_Clear(buffer);
+  if (res && res!=0x26 && res!=TPM_RC_INITIALIZE)
     out_description("TPM_Startup() failed", res);
 
-  CHECK3(-62, tis_deactivate_all(), "tis_deactivate failed");
-  return tpm;
+  res = *tpm2 ? tpm2_selftest_start(buffer) : TPM_ContinueSelfTest_Start(buffer);
+  CHECK3(-63, res < 0, "could not start the self test");
+  return 0;
+}
+
+
+/**
+ * Wait for the self test and release the TPM for skinit.
+ */
+static
+int
+finish_tpm(unsigned char *buffer, int tpm2)
+{
+  int res;
+
+  if ((res = tpm2 ? tpm2_finish(buffer) : TPM_Finish(buffer, TPM2_BUFFER_SIZE)))
+    out_description("TPM self test failed", res);
+  CHECK3(-64, tis_deactivate_all(), "tis_deactivate failed");
+  return 0;
 }
 
 
+#ifdef CONFIG_DRYRUN
+/**
+ * Run the code after skinit without skinit, e.g. on Intel machines or
+ * in QEMU, to profile the measurement of the modules.  The stub is
+ * skipped and PCR17 was not reset, thus the PCR values are worthless.
+ */
+static
+int
+dryrun(struct mbi *mbi, unsigned char *buffer)
+{
+  int tpm2 = 0;
+
+  out_info("dry run without skinit");
+  if (0 < start_tpm(buffer) && !selftest_tpm(buffer, &tpm2))
+    {
+      trace("finish");
+      ERROR(14, finish_tpm(buffer, tpm2), "could not release the TPM");
+    }
+  else
+    tis_deactivate_all();
+  return oslo(mbi);
+}
+#endif
+
+
 /**
  * This function runs before skinit and has to enable SVM in the processor
  * and disable all localities.
@@ -92,11 +226,12 @@ int
 __main(struct mbi *mbi, unsigned flags)
 {
 
-  unsigned char buffer[TCG_BUFFER_SIZE];
+  unsigned char buffer[TPM2_BUFFER_SIZE];
 
 #ifndef NDEBUG
   serial_init();
 #endif
+  trace("main");
   out_string(version_string);
   ERROR(10, !mbi || flags != MBI_MAGIC, "not loaded via multiboot");
 
@@ -104,14 +239,21 @@ __main(struct mbi *mbi, unsigned flags)
   mbi->flags |= MBI_FLAG_BOOT_LOADER_NAME;
   mbi->boot_loader_name = (unsigned) version_string;
 
-  int revision = 0;
-  if (0 >= prepare_tpm(buffer) || (0 > (revision = check_cpuid())))
+#ifdef CONFIG_DRYRUN
+  return dryrun(mbi, buffer);
+#endif
+  int tpm, revision = 0, tpm2 = 0;
+  if (0 >= (tpm = start_tpm(buffer)) || (0 > (revision = check_cpuid())) || selftest_tpm(buffer, &tpm2))
     {
       if (0 > revision)
 	out_info("No SVM platform");
       else
 	out_info("Could not prepare the TPM");
 
+      // collect the TPM2_Startup still in flight and release the TPM for the OS
+      if (0 < tpm && 0 > revision)
+	tis_transmit_finish(buffer, TPM2_BUFFER_SIZE);
+      tis_deactivate_all();
       ERROR(11, start_module(mbi), "start module failed");
     }
 
@@ -124,8 +266,13 @@ __main(struct mbi *mbi, unsigned flags)
    */
   ERROR(13, stop_processors(), "sending an INIT IPI to other processors failed");
 
+  trace("wait");
   wait(1000);
+  trace("finish");
+  ERROR(14, finish_tpm(buffer, tpm2), "could not release the TPM");
   out_info("call skinit");
+  trace("skinit");
+  trace_dump();
   do_skinit();
 }
 
@@ -137,22 +284,63 @@ int
 oslo(struct mbi *mbi)
 {
   struct Context ctx;
+  struct Sha256Context ctx256;
+  unsigned char buffer[TPM2_BUFFER_SIZE];
 
+  trace("oslo");
   ERROR(20, !mbi, "no mbi in oslo()");
 
   if (tis_init(TIS_BASE))
     {
-      ERROR(21, !tis_access(TIS_LOCALITY_2, 0), "could not gain TIS ownership");
-      ERROR(22, mbi_calc_hash(mbi, &ctx),  "calc hash failed");
-      show_hash("PCR[19]: ",ctx.hash);
-
-#ifndef NDEBUG
-      int res;
-      dump_pcrs(ctx.buffer);
+      int access = tis_access(TIS_LOCALITY_2, 0);
+#ifdef CONFIG_DRYRUN
+      // without skinit locality 2 is closed on e.g. Intel machines
+      if (!access && !tis_deactivate_all() && (access = tis_access(TIS_LOCALITY_0, 0)))
+	{
+	  out_info("locality 0, modules go into PCR23");
+	  modules_pcr = 23;
+	}
+#endif
+      ERROR(21, !access, "could not gain TIS ownership");
+      if (0 > tpm2_detect(buffer))
+	{
+	  out_info("modules stay unmeasured");
+	  ERROR(24, tis_deactivate_all(), "tis_deactivate failed");
+	  ERROR(26, start_module(mbi), "start module failed");
+	}
+      if (mem_init(mbi))
+	out_info("no memory map for the event log");
+      else if (!tcglog_init(mbi, tpm2_banks))
+	{
+	  trace("measure");
+	  log_oslo(&ctx, &ctx256);
+	}
+      trace("modules");
+      ERROR(22, mbi_calc_hash(mbi, buffer, &ctx, &ctx256),  "calc hash failed");
 
-      CHECK4(24,(res = TPM_PcrRead(ctx.buffer, 17, ctx.hash)), "TPM_PcrRead failed", res);
-      show_hash("PCR[17]: ",ctx.hash);
+#if !defined(NDEBUG) && defined(CONFIG_DEBUG_PCRS)
+      if (!tpm2_banks)
+	dump_pcrs(buffer);
 #endif
+
+      /**
+       * Read the final PCR values once, so that the OS does not need
+       * to ask the TPM again.
+       */
+      int res;
+      unsigned char pcrs[40];
+      trace("pcrs");
+      if ((res = read_pcrs(buffer, pcrs)))
+	{
+	  out_description("TPM_PcrRead failed", res);
+	  tcglog_handoff(mbi, 0, 0);
+	}
+      else
+	{
+	  show_hash("PCR[17]: ", pcrs);
+	  show_hash("PCR[19]: ", pcrs + 20);
+	  tcglog_handoff(mbi, pcrs, pcrs + 20);
+	}
       ERROR(25, tis_deactivate_all(), "tis_deactivate failed");
   }
   ERROR(27, start_module(mbi), "start module failed");
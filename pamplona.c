@@ -19,18 +19,127 @@
 #include "mp.h"
 #include "dev.h"
 #include "pamplona.h"
+#include "mem.h"
+#include "acpi.h"
+#include "stage.h"
+#include "trace.h"
 
+#ifndef STAGED
 const char *message_label = "PAMPLONA: ";
-const unsigned REALMODE_CODE = 0x20000;
+#endif
+const unsigned REALMODE_LIMIT = 1 << 20;
 const char *CPU_NAME =  "AMD CPU booted by OSLO/PAMPLONA";
 
 
+/**
+ * Return the address of a symbol in the copied AP code.
+ */
+static
+unsigned
+park_addr(unsigned base, char *symbol)
+{
+  return base + (symbol - &smp_init_start);
+}
+
+
+/**
+ * Count the enabled processors in the MADT.
+ */
+static
+unsigned
+park_count_cpus(struct acpi_madt *madt)
+{
+  unsigned res = 0;
+  for (unsigned i = sizeof(*madt); i + sizeof(struct acpi_subtable) <= madt->hdr.length; )
+    {
+      struct acpi_subtable *sub = (struct acpi_subtable *) ((char *) madt + i);
+      if (sub->length < sizeof(*sub))
+	break;
+      if (sub->type == ACPI_MADT_LAPIC && *(unsigned *) ((char *) sub + 4) & ACPI_MADT_ENABLED)
+	res++;
+      if (sub->type == ACPI_MADT_X2APIC && *(unsigned *) ((char *) sub + 8) & ACPI_MADT_ENABLED)
+	res++;
+      i += sub->length;
+    }
+  return res;
+}
+
+
+/**
+ * Install a copy of the MADT that describes the mailbox with a
+ * multiprocessor wakeup structure.
+ */
+static
+int
+park_install_madt(struct acpi_madt *madt, unsigned base)
+{
+  struct acpi_madt *copy = (struct acpi_madt *) (base + PARK_MADT);
+  memcpy(copy, madt, madt->hdr.length);
+
+  struct acpi_madt_mp_wakeup *wakeup = (struct acpi_madt_mp_wakeup *) ((char *) copy + copy->hdr.length);
+  wakeup->type = ACPI_MADT_MP_WAKEUP;
+  wakeup->length = sizeof(*wakeup);
+  wakeup->mailbox_addr = base + PARK_MAILBOX;
+  copy->hdr.length += sizeof(*wakeup);
+  acpi_fix_checksum(&copy->hdr);
+  return acpi_replace_table(&madt->hdr, &copy->hdr);
+}
+
+
+/**
+ * Start the APs and let them park in long mode on a mailbox instead
+ * of halting, so that the OS can wake them with a single write
+ * instead of INIT-SIPI-SIPI.  The memory is reserved in the memory
+ * map passed to the next module.  Without a MADT to announce the
+ * mailbox or a memory map to reserve it, the APs just halt.
+ */
+static
+int
+park_processors(struct mbi *mbi)
+{
+  struct acpi_madt *madt = (struct acpi_madt *) acpi_find_table("APIC");
+  unsigned size = PARK_MADT + (madt ? madt->hdr.length + sizeof(struct acpi_madt_mp_wakeup) : 0);
+  unsigned base;
+  CHECK3(-1, !(base = mem_alloc(size, REALMODE_LIMIT)), "no memory for the AP code");
+  memset((char *) base, 0, size);
+  memcpy((char *) base, &smp_init_start, &smp_init_end - &smp_init_start);
+
+  // identity map the first 4G with large pages
+  unsigned long long *pml4 = (unsigned long long *) (base + PARK_PML4);
+  unsigned long long *pdpt = (unsigned long long *) (base + PARK_PDPT);
+  unsigned long long *pd   = (unsigned long long *) (base + PARK_PD);
+  pml4[0] = (base + PARK_PDPT) | PTE_PRESENT | PTE_WRITE;
+  for (unsigned i=0; i < 4; i++)
+    pdpt[i] = (base + PARK_PD + i * 0x1000) | PTE_PRESENT | PTE_WRITE;
+  for (unsigned i=0; i < 4 * 512; i++)
+    pd[i] = ((unsigned long long) i << 21) | PTE_PRESENT | PTE_WRITE | PTE_LARGE;
+
+  *(unsigned *) (park_addr(base, &smp_gdt_desc) + 2) = park_addr(base, &smp_gdt);
+  *(unsigned *) park_addr(base, &smp_long_jump) = park_addr(base, &smp_long);
+  *(unsigned *) park_addr(base, &smp_cr3) = base + PARK_PML4;
+
+  if (!madt || mem_mmap_reserve(mbi, base, size) || park_install_madt(madt, base))
+    out_info("can not announce the mailbox, halt the APs");
+  else
+    *(unsigned *) park_addr(base, &smp_mailbox) = base + PARK_MAILBOX;
+  CHECK3(-4, start_processors(base), "sending an STARTUP IPI to other processors failed");
+
+  // wait until all APs are parked
+  unsigned cpus = madt ? park_count_cpus(madt) : 0;
+  volatile unsigned *parked = (unsigned *) park_addr(base, &smp_parked);
+  for (unsigned i=0; i < PARK_TIMEOUT && *parked + 1 < cpus; i++)
+    wait(1);
+  out_description("parked APs", *parked);
+  return 0;
+}
+
+
 /**
  * Fix some issues that unmodified OS's could start after oslo.
  * This should only be called if check_cpuid() succeded.
  */
 int
-pamplona_fixup()
+pamplona_fixup(struct mbi *mbi)
 {
   unsigned i;
 
@@ -39,14 +148,13 @@ pamplona_fixup()
   for (i=0; i<6; i++)
     wrmsr(0xc0010030+i, * (unsigned long long*) (CPU_NAME+i*8));
 
-  out_info("halt APs in init state");
+  out_info("park APs");
   int revision;
 
   /**
    * Start the stopped APs and execute some fixup code.
    */
-  memcpy((char *) REALMODE_CODE, &smp_init_start, &smp_init_end - &smp_init_start);
-  CHECK3(-2, start_processors(REALMODE_CODE), "sending an STARTUP IPI to other processors failed");
+  CHECK3(-1, park_processors(mbi), "could not park the APs");
 
 
   CHECK3(12, (revision = enable_svm()), "could not enable SVM");
@@ -58,47 +166,77 @@ pamplona_fixup()
 }
 
 
+#if defined(STAGED) && defined(CONFIG_DEV)
+/**
+ * Replace the all-or-nothing protection by a DEV bitmap that covers
+ * only the loader, the MBI and the modules, so that devices can DMA
+ * while the following stages run.  MUNICH or STAGED disable it before
+ * the OS is started.
+ */
+static
 int
-__main(struct mbi *mbi, unsigned flags)
+pamplona_dev(struct mbi *mbi)
 {
-#ifndef NDEBUG
-  serial_init();
+  unsigned bitmap, sldev;
+  CHECK3(-1, !(bitmap = mem_alloc(1 << 17, 0)), "no memory for the DEV bitmap");
+  CHECK3(-2, !(sldev = mem_alloc(1 << 12, 0)), "no memory for the DEV bitmap");
+  return enable_dev_protection((unsigned *) sldev, (unsigned char *) bitmap, mbi);
+}
+#else
+static inline
+int
+pamplona_dev(struct mbi *mbi)
+{
+  (void) mbi;
+  return -1;
+}
 #endif
 
-  out_info(VERSION " executes fixup code");
-  ERROR(10, !mbi || flags != MBI_MAGIC, "not loaded via multiboot");
 
+/**
+ * The pamplona stage. Expects an initialized memory allocator.
+ */
+int
+pamplona(struct mbi *mbi)
+{
+  trace("pamplona");
   ERROR(12, pci_iterate_devices(), "could not iterate over the devices");
+#ifndef NDEBUG
+  mem_dump();
+#endif
 
   if (0 < check_cpuid())
     {
 
-      CHECK3(11, pamplona_fixup(), "fixup failed");
+      CHECK3(11, pamplona_fixup(mbi), "fixup failed");
       out_info("fixup done");
 
-      if (disable_dev_protection())
+      if (pamplona_dev(mbi) && disable_dev_protection())
 	out_info("DEV disable failed");
     }
 
-#if 0
-  out_info("MMAP");
-  out_description("addr", mbi->mmap_addr);
-  out_description("len",  mbi->mmap_length);
+  out_info("done");
+  return 0;
+}
 
-  unsigned i;
-  for ( i =  mbi->mmap_addr; i < mbi->mmap_addr + mbi->mmap_length; i += ((unsigned *)i)[0])
-    {
-      out_description("size",((unsigned *)i)[0]);
-      out_description("addr low",((unsigned *)i)[1]);
-      out_description("addr high",((unsigned *)i)[2]);
-      out_description("length low",((unsigned *)i)[3]);
-      out_description("length high",((unsigned *)i)[4]);
-      out_description("type",((unsigned *)i)[5]);
-    }
 
+#ifndef STAGED
+int
+__main(struct mbi *mbi, unsigned flags)
+{
+#ifndef NDEBUG
+  serial_init();
 #endif
-  out_info("done");
+
+  trace("main");
+  out_info(VERSION " executes fixup code");
+  ERROR(10, !mbi || flags != MBI_MAGIC, "not loaded via multiboot");
+  trace("mem");
+  ERROR(15, mem_init(mbi), "could not parse the memory map");
+  ERROR(11, pamplona(mbi), "fixup failed");
+
   //wait(1000);
   ERROR(13, start_module(mbi), "start module failed");
   return 14;
 }
+#endif
@@ -0,0 +1,720 @@
+/*
+ * \brief   Calculates the expected PCR17 and PCR19 values of OSLO.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * A host tool.  PCR17 is extended by skinit with the hash of the SLB
+ * and by the stub with the hash of the rest of OSLO.  Both ranges are
+ * described by the SLB header at the first 64k boundary of the
+ * loaded image.
+ *
+ * PCR19 is extended by OSLO with the hash of every module and by
+ * BEIRUT, if it is the first module, with a single hash over the
+ * command lines of the following modules including the hand-off
+ * module of OSLO.
+ *
+ * The module files of all boot configurations are hashed once in
+ * parallel.  A cache file keeps the digests of unchanged files,
+ * identified by device, inode, size and mtime, between runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sha.h"
+#include "sha256.h"
+
+
+enum pcrcalc_constants
+  {
+    SHA1_SIZE     = 20,
+    SHA256_SIZE   = 32,
+    HASH_CHUNK    = 1 << 24,
+    MAX_THREADS   = 256,
+    HANDOFF_NAME_SIZE = 13,
+  };
+
+
+/**
+ * A module file and its digests.
+ */
+struct file
+{
+  char *path;
+  struct stat st;
+  int hashed;
+  int sha256_hashed;
+  int error;
+  unsigned char sha1[SHA1_SIZE];
+  unsigned char sha256[SHA256_SIZE];
+};
+
+
+/**
+ * A multiboot module of a configuration: the string the loader
+ * passes and the file behind its first word.
+ */
+struct module
+{
+  char *string;
+  unsigned file;
+};
+
+
+/**
+ * A boot configuration is a range of modules.
+ */
+struct config
+{
+  const char *name;
+  unsigned first;
+  unsigned count;
+};
+
+
+const char *message_label = "PCRCALC: ";
+
+static struct file *files;
+static unsigned file_count;
+static struct module *modules;
+static unsigned module_count;
+static struct config *configs;
+static unsigned config_count;
+
+static const char *root = "";
+static int sha256_bank;
+static int beirut;
+static int handoff = 1;
+
+static char **cache_lines;
+static unsigned cache_count;
+
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned next_file;
+
+
+void
+out_string(const char *value)
+{
+  fputs(value, stderr);
+}
+
+void
+__exit(unsigned status)
+{
+  exit(status);
+}
+
+
+static
+void *
+xrealloc(void *ptr, size_t size)
+{
+  if (!(ptr = realloc(ptr, size)))
+    {
+      perror("realloc");
+      exit(2);
+    }
+  return ptr;
+}
+
+
+static
+void
+hash(const unsigned char *data, unsigned len, unsigned char *out)
+{
+  struct Context ctx;
+  sha1_init(&ctx);
+  sha1(&ctx, (unsigned char *) data, len);
+  sha1_finish(&ctx);
+  memcpy(out, ctx.hash, SHA1_SIZE);
+}
+
+
+static
+void
+hash256(const unsigned char *data, unsigned len, unsigned char *out)
+{
+  struct Sha256Context ctx;
+  sha256_init(&ctx);
+  sha256(&ctx, (unsigned char *) data, len);
+  sha256_finish(&ctx);
+  memcpy(out, ctx.hash, SHA256_SIZE);
+}
+
+
+static
+void
+extend(unsigned char *pcr, const unsigned char *digest)
+{
+  unsigned char buffer[2 * SHA1_SIZE];
+  memcpy(buffer, pcr, SHA1_SIZE);
+  memcpy(buffer + SHA1_SIZE, digest, SHA1_SIZE);
+  hash(buffer, sizeof(buffer), pcr);
+}
+
+
+static
+void
+extend256(unsigned char *pcr, const unsigned char *digest)
+{
+  unsigned char buffer[2 * SHA256_SIZE];
+  memcpy(buffer, pcr, SHA256_SIZE);
+  memcpy(buffer + SHA256_SIZE, digest, SHA256_SIZE);
+  hash256(buffer, sizeof(buffer), pcr);
+}
+
+
+static
+void
+print_hex(const unsigned char *value, unsigned len)
+{
+  for (unsigned i=0; i < len; i++)
+    printf("%02x", value[i]);
+}
+
+
+static
+void
+show(const char *name, const unsigned char *value, unsigned len)
+{
+  printf("%-11s", name);
+  print_hex(value, len);
+  printf("\n");
+}
+
+
+/**
+ * Load the PT_LOAD segments of an ELF file into a flat image.
+ */
+static
+unsigned char *
+load_elf(const char *name, unsigned *base, unsigned *size)
+{
+  FILE *f = fopen(name, "rb");
+  if (!f)
+    {
+      perror(name);
+      return 0;
+    }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  rewind(f);
+  unsigned char *file = malloc(len);
+  if (!file || fread(file, 1, len, f) != (size_t) len)
+    {
+      fprintf(stderr, "%s: read failed\n", name);
+      fclose(f);
+      return 0;
+    }
+  fclose(f);
+
+  Elf32_Ehdr *ehdr = (Elf32_Ehdr *) file;
+  if (len < (long) sizeof(*ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) || ehdr->e_ident[EI_CLASS] != ELFCLASS32)
+    {
+      fprintf(stderr, "%s: not an ELF32 file\n", name);
+      return 0;
+    }
+
+  unsigned start = ~0u, end = 0;
+  Elf32_Phdr *phdr = (Elf32_Phdr *) (file + ehdr->e_phoff);
+  for (unsigned i=0; i < ehdr->e_phnum; i++)
+    if (phdr[i].p_type == PT_LOAD)
+      {
+	if (phdr[i].p_paddr < start)
+	  start = phdr[i].p_paddr;
+	if (phdr[i].p_paddr + phdr[i].p_memsz > end)
+	  end = phdr[i].p_paddr + phdr[i].p_memsz;
+      }
+  if (start >= end)
+    {
+      fprintf(stderr, "%s: nothing to load\n", name);
+      return 0;
+    }
+
+  unsigned char *image = calloc(1, end - start);
+  for (unsigned i=0; i < ehdr->e_phnum; i++)
+    if (phdr[i].p_type == PT_LOAD)
+      memcpy(image + phdr[i].p_paddr - start, file + phdr[i].p_offset, phdr[i].p_filesz);
+  free(file);
+  *base = start;
+  *size = end - start;
+  return image;
+}
+
+
+/**
+ * Calculate PCR17 from the SLB and the rest of OSLO.  The SHA-256
+ * bank gets the same measurements: skinit and the stub extend all
+ * banks.
+ */
+static
+int
+calc_pcr17(const char *name)
+{
+  unsigned base, size;
+  unsigned char *image = load_elf(name, &base, &size);
+  if (!image)
+    return 2;
+
+  unsigned offset = ((base + 0xffff) & ~0xffff) - base;
+  unsigned char *slb = image + offset;
+  unsigned slb_len = slb[2] | slb[3] << 8;
+  unsigned rest_end = slb[4] | slb[5] << 8 | slb[6] << 16 | slb[7] << 24;
+  if (offset + 8 > size || offset + rest_end > size || slb_len > rest_end)
+    {
+      fprintf(stderr, "%s: invalid SLB header\n", name);
+      return 3;
+    }
+
+  unsigned char pcr[SHA1_SIZE] = {0}, digest[SHA1_SIZE];
+  hash(slb, slb_len, digest);
+  show("SLB:", digest, SHA1_SIZE);
+  extend(pcr, digest);
+  hash(slb + slb_len, rest_end - slb_len, digest);
+  show("REST:", digest, SHA1_SIZE);
+  extend(pcr, digest);
+  show("PCR17:", pcr, SHA1_SIZE);
+
+  if (sha256_bank)
+    {
+      unsigned char pcr256[SHA256_SIZE] = {0}, digest256[SHA256_SIZE];
+      hash256(slb, slb_len, digest256);
+      extend256(pcr256, digest256);
+      hash256(slb + slb_len, rest_end - slb_len, digest256);
+      extend256(pcr256, digest256);
+      show("PCR17-256:", pcr256, SHA256_SIZE);
+    }
+  free(image);
+  return 0;
+}
+
+
+/**
+ * Return the index of the file behind the first word of a module
+ * string.  Files are added only once.
+ */
+static
+unsigned
+add_file(const char *string)
+{
+  size_t len = strcspn(string, " \t");
+  char *path = xrealloc(0, strlen(root) + len + 1);
+  strcpy(path, root);
+  strncat(path, string, len);
+
+  for (unsigned i=0; i < file_count; i++)
+    if (!strcmp(files[i].path, path))
+      {
+	free(path);
+	return i;
+      }
+  files = xrealloc(files, (file_count + 1) * sizeof(*files));
+  memset(files + file_count, 0, sizeof(*files));
+  files[file_count].path = path;
+  return file_count++;
+}
+
+
+static
+void
+add_module(char *string)
+{
+  while (*string == ' ' || *string == '\t')
+    string++;
+  size_t len = strlen(string);
+  while (len && (string[len - 1] == ' ' || string[len - 1] == '\t' || string[len - 1] == '\n'))
+    string[--len] = 0;
+  if (!len)
+    return;
+  modules = xrealloc(modules, (module_count + 1) * sizeof(*modules));
+  modules[module_count].string = string;
+  modules[module_count].file = add_file(string);
+  module_count++;
+  configs[config_count - 1].count++;
+}
+
+
+static
+void
+add_config(const char *name)
+{
+  configs = xrealloc(configs, (config_count + 1) * sizeof(*configs));
+  configs[config_count].name = name;
+  configs[config_count].first = module_count;
+  configs[config_count].count = 0;
+  config_count++;
+}
+
+
+/**
+ * Read configurations, one per line with the modules separated by ';'.
+ */
+static
+int
+read_configs(const char *name)
+{
+  FILE *f = strcmp(name, "-") ? fopen(name, "r") : stdin;
+  if (!f)
+    {
+      perror(name);
+      return 1;
+    }
+  char *line = 0;
+  size_t size = 0;
+  while (getline(&line, &size, f) > 0)
+    {
+      if (line[0] == '#' || line[strspn(line, " \t\n")] == 0)
+	continue;
+      char *copy = strdup(line);
+      copy[strcspn(copy, "\n")] = 0;
+      add_config(copy);
+      for (char *module = strtok(line, ";"); module; module = strtok(0, ";"))
+	add_module(strdup(module));
+      line = 0;
+      size = 0;
+    }
+  free(line);
+  if (f != stdin)
+    fclose(f);
+  return 0;
+}
+
+
+/**
+ * Is a file of this run on the given device and inode?
+ */
+static
+struct file *
+find_file(unsigned long long dev, unsigned long long ino)
+{
+  for (unsigned i=0; i < file_count; i++)
+    if (!files[i].error && files[i].st.st_dev == dev && files[i].st.st_ino == ino)
+      return files + i;
+  return 0;
+}
+
+
+/**
+ * Take the digests of unchanged files from the cache file.  A line
+ * holds device, inode, size, mtime, SHA1, SHA-256 or '-' and the
+ * path.  Lines of other files are kept for the next run.
+ */
+static
+void
+read_cache(const char *name)
+{
+  FILE *f = fopen(name, "r");
+  if (!f)
+    return;
+
+  char *line = 0;
+  size_t len = 0;
+  while (getline(&line, &len, f) > 0)
+    {
+      unsigned long long dev, ino, size, sec, nsec;
+      char sha1_hex[2 * SHA1_SIZE + 1], sha256_hex[2 * SHA256_SIZE + 1];
+      if (sscanf(line, "%llu %llu %llu %llu %llu %40s %64s", &dev, &ino, &size, &sec, &nsec, sha1_hex, sha256_hex) != 7)
+	continue;
+
+      struct file *file = find_file(dev, ino);
+      if (!file)
+	{
+	  cache_lines = xrealloc(cache_lines, (cache_count + 1) * sizeof(*cache_lines));
+	  cache_lines[cache_count++] = strdup(line);
+	  continue;
+	}
+      int has256 = strlen(sha256_hex) == 2 * SHA256_SIZE;
+      if (file->hashed || (unsigned long long) file->st.st_size != size || (unsigned long long) file->st.st_mtim.tv_sec != sec
+	  || (unsigned long long) file->st.st_mtim.tv_nsec != nsec || (sha256_bank && !has256))
+	continue;
+      for (unsigned j=0; j < SHA1_SIZE; j++)
+	sscanf(sha1_hex + 2 * j, "%2hhx", file->sha1 + j);
+      for (unsigned j=0; has256 && j < SHA256_SIZE; j++)
+	sscanf(sha256_hex + 2 * j, "%2hhx", file->sha256 + j);
+      file->hashed = 1;
+      file->sha256_hashed = has256;
+    }
+  free(line);
+  fclose(f);
+}
+
+
+static
+void
+write_cache(const char *name)
+{
+  FILE *f = fopen(name, "w");
+  if (!f)
+    {
+      perror(name);
+      return;
+    }
+  for (unsigned i=0; i < file_count; i++)
+    {
+      struct file *file = files + i;
+      if (file->error || !file->hashed)
+	continue;
+      fprintf(f, "%llu %llu %llu %llu %llu ", (unsigned long long) file->st.st_dev, (unsigned long long) file->st.st_ino,
+	      (unsigned long long) file->st.st_size, (unsigned long long) file->st.st_mtim.tv_sec,
+	      (unsigned long long) file->st.st_mtim.tv_nsec);
+      for (unsigned j=0; j < SHA1_SIZE; j++)
+	fprintf(f, "%02x", file->sha1[j]);
+      fprintf(f, " ");
+      if (file->sha256_hashed)
+	for (unsigned j=0; j < SHA256_SIZE; j++)
+	  fprintf(f, "%02x", file->sha256[j]);
+      else
+	fprintf(f, "-");
+      fprintf(f, " %s\n", file->path);
+    }
+  for (unsigned i=0; i < cache_count; i++)
+    fputs(cache_lines[i], f);
+  fclose(f);
+}
+
+
+/**
+ * Hash a whole file like mbi_calc_hash() hashes a module.
+ */
+static
+void
+hash_file(struct file *file)
+{
+  int fd = open(file->path, O_RDONLY);
+  if (fd < 0)
+    {
+      file->error = 1;
+      return;
+    }
+
+  struct Context ctx;
+  struct Sha256Context ctx256;
+  sha1_init(&ctx);
+  sha256_init(&ctx256);
+  unsigned char *data = 0;
+  if (file->st.st_size)
+    data = mmap(0, file->st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    {
+      file->error = 1;
+      return;
+    }
+  for (off_t pos = 0; pos < file->st.st_size; pos += HASH_CHUNK)
+    {
+      unsigned len = file->st.st_size - pos < HASH_CHUNK ? file->st.st_size - pos : HASH_CHUNK;
+      sha1(&ctx, data + pos, len);
+      if (sha256_bank)
+	sha256(&ctx256, data + pos, len);
+    }
+  if (data)
+    munmap(data, file->st.st_size);
+  sha1_finish(&ctx);
+  memcpy(file->sha1, ctx.hash, SHA1_SIZE);
+  if (sha256_bank)
+    {
+      sha256_finish(&ctx256);
+      memcpy(file->sha256, ctx256.hash, SHA256_SIZE);
+      file->sha256_hashed = 1;
+    }
+  file->hashed = 1;
+}
+
+
+/**
+ * A worker thread hashes the next file without a digest.
+ */
+static
+void *
+hash_worker(void *arg)
+{
+  (void) arg;
+  while (1)
+    {
+      pthread_mutex_lock(&next_lock);
+      unsigned i = next_file++;
+      pthread_mutex_unlock(&next_lock);
+      if (i >= file_count)
+	return 0;
+      if (!files[i].hashed && !files[i].error)
+	hash_file(files + i);
+    }
+}
+
+
+/**
+ * Calculate PCR19 of a configuration.  The module list is the one
+ * OSLO gets, thus the first module is BEIRUT if it is used.
+ */
+static
+int
+calc_pcr19(struct config *config, unsigned char *pcr, unsigned char *pcr256)
+{
+  struct module *m = modules + config->first;
+
+  memset(pcr, 0, SHA1_SIZE);
+  memset(pcr256, 0, SHA256_SIZE);
+  for (unsigned i=0; i < config->count; i++)
+    {
+      struct file *file = files + m[i].file;
+      if (file->error)
+	{
+	  fprintf(stderr, "%s: can not hash\n", file->path);
+	  return 1;
+	}
+      extend(pcr, file->sha1);
+      if (sha256_bank)
+	extend256(pcr256, file->sha256);
+    }
+
+  if (beirut && config->count)
+    {
+      struct Context ctx;
+      struct Sha256Context ctx256;
+      sha1_init(&ctx);
+      sha256_init(&ctx256);
+      for (unsigned i=1; i < config->count; i++)
+	{
+	  sha1(&ctx, (unsigned char *) m[i].string, strlen(m[i].string) + 1);
+	  sha256(&ctx256, (unsigned char *) m[i].string, strlen(m[i].string) + 1);
+	}
+      if (handoff)
+	{
+	  sha1(&ctx, (unsigned char *) "oslo_handoff", HANDOFF_NAME_SIZE);
+	  sha256(&ctx256, (unsigned char *) "oslo_handoff", HANDOFF_NAME_SIZE);
+	}
+      sha1_finish(&ctx);
+      sha256_finish(&ctx256);
+      extend(pcr, ctx.hash);
+      if (sha256_bank)
+	extend256(pcr256, ctx256.hash);
+    }
+  return 0;
+}
+
+
+static
+void
+usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-2bn] [-f configs] [-c cache] [-r root] [-j threads] oslo [module...]\n"
+	  "  -2  calculate the SHA-256 bank of a TPM 2.0 as well\n"
+	  "  -b  the first module is BEIRUT\n"
+	  "  -n  OSLO did not append the hand-off module\n"
+	  "  -f  read configurations, one per line with the modules separated by ';'\n"
+	  "  -c  a cache file for the digests of the module files\n"
+	  "  -r  the directory the module paths are relative to\n"
+	  "  -j  the number of threads that hash module files\n"
+	  "A module is given as the string the loader passes, its first word\n"
+	  "is the file.  The oslo binary can be '-' to skip PCR17.\n", name);
+  exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  const char *config_file = 0;
+  const char *cache = 0;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+
+  while ((opt = getopt(argc, argv, "2bnf:c:r:j:")) != -1)
+    switch (opt)
+      {
+      case '2': sha256_bank = 1; break;
+      case 'b': beirut = 1; break;
+      case 'n': handoff = 0; break;
+      case 'f': config_file = optarg; break;
+      case 'c': cache = optarg; break;
+      case 'r': root = optarg; break;
+      case 'j': threads = strtol(optarg, 0, 0); break;
+      default: usage(argv[0]);
+      }
+  if (optind >= argc)
+    usage(argv[0]);
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_THREADS)
+    threads = MAX_THREADS;
+
+  const char *oslo = argv[optind++];
+  if (strcmp(oslo, "-") && calc_pcr17(oslo))
+    return 2;
+
+  if (optind < argc)
+    {
+      add_config("");
+      while (optind < argc)
+	add_module(argv[optind++]);
+    }
+  if (config_file && read_configs(config_file))
+    return 2;
+  if (!module_count)
+    return 0;
+
+  for (unsigned i=0; i < file_count; i++)
+    if (stat(files[i].path, &files[i].st))
+      {
+	perror(files[i].path);
+	files[i].error = 1;
+      }
+  if (cache)
+    read_cache(cache);
+
+  pthread_t workers[MAX_THREADS];
+  for (long i=0; i < threads; i++)
+    if (pthread_create(workers + i, 0, hash_worker, 0))
+      {
+	threads = i;
+	break;
+      }
+  if (!threads)
+    hash_worker(0);
+  for (long i=0; i < threads; i++)
+    pthread_join(workers[i], 0);
+  if (cache)
+    write_cache(cache);
+
+  int res = 0;
+  unsigned char pcr[SHA1_SIZE], pcr256[SHA256_SIZE];
+  for (unsigned i=0; i < config_count; i++)
+    {
+      if (calc_pcr19(configs + i, pcr, pcr256))
+	{
+	  res = 4;
+	  continue;
+	}
+      if (!config_file)
+	{
+	  show("PCR19:", pcr, SHA1_SIZE);
+	  if (sha256_bank)
+	    show("PCR19-256:", pcr256, SHA256_SIZE);
+	  continue;
+	}
+      print_hex(pcr, SHA1_SIZE);
+      if (sha256_bank)
+	{
+	  printf(" ");
+	  print_hex(pcr256, SHA256_SIZE);
+	}
+      printf(" %s\n", configs[i].name);
+    }
+  return res;
+}
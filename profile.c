@@ -0,0 +1,156 @@
+/*
+ * \brief   A sampling profiler driven by the local APIC timer.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * The loader runs without an IDT and with interrupts disabled.  For
+ * profiling, a minimal IDT with the timer and the spurious vector is
+ * loaded, the PICs are masked and the local APIC timer interrupts
+ * PROFILE_RATE times a second.  Every interrupt samples the
+ * interrupted EIP.  profile_stop() restores the previous state and
+ * prints the samples as 'PROFILE <eip>' lines, which profile.sh maps
+ * to the symbols of the binary.
+ *
+ * Note that skinit clears the global interrupt flag, thus there are
+ * no samples after it until PAMPLONA sets it again.
+ */
+
+#include "asm.h"
+#include "util.h"
+#include "mp.h"
+#include "profile.h"
+
+#ifdef CONFIG_PROFILE
+
+struct idt_desc
+{
+  unsigned short limit;
+  unsigned base;
+} __attribute__((packed));
+
+
+static struct idt_gate profile_idt[PROFILE_SPURIOUS + 1];
+static struct idt_desc profile_old_idt;
+static unsigned profile_samples[PROFILE_SAMPLES];
+static unsigned profile_count;
+static unsigned profile_lost;
+static unsigned profile_apic;
+static unsigned profile_old_svr;
+static unsigned char profile_old_pic[2];
+
+
+static inline
+volatile unsigned *
+apic_reg(unsigned offset)
+{
+  return (volatile unsigned *) (profile_apic + offset);
+}
+
+
+static
+void
+profile_gate(unsigned vector, void (*func)(void))
+{
+  unsigned short cs;
+  asm volatile ("mov %%cs, %0" : "=r"(cs));
+  profile_idt[vector].offset_low  = (unsigned) func;
+  profile_idt[vector].selector    = cs;
+  profile_idt[vector].flags       = IDT_INTERRUPT_GATE;
+  profile_idt[vector].offset_high = (unsigned) func >> 16;
+}
+
+
+/**
+ * Called by profile_irq with the interrupted EIP.
+ */
+void
+profile_sample(unsigned eip)
+{
+  if (profile_count < PROFILE_SAMPLES)
+    profile_samples[profile_count++] = eip;
+  else
+    profile_lost++;
+  *apic_reg(APIC_EOI) = 0;
+}
+
+
+/**
+ * Install the IDT and start the APIC timer.  The timer is
+ * calibrated with the PIT.
+ */
+void
+profile_start(void)
+{
+  unsigned long long value = rdmsr(MSR_APIC_BASE);
+  if (profile_apic || !(value & APIC_BASE_ENABLE) || (value >> 32) & 0xf)
+    return;
+  profile_apic = value & 0xfffff000;
+  profile_count = 0;
+  profile_lost = 0;
+
+  profile_gate(PROFILE_VECTOR, profile_irq);
+  profile_gate(PROFILE_SPURIOUS, profile_spurious);
+  struct idt_desc desc = { sizeof(profile_idt) - 1, (unsigned) profile_idt };
+  asm volatile ("sidt %0" : "=m"(profile_old_idt));
+  asm volatile ("lidt %0" :: "m"(desc));
+
+  // only the APIC timer should interrupt us
+  profile_old_pic[0] = inb(PIC_MASTER_DATA);
+  profile_old_pic[1] = inb(PIC_SLAVE_DATA);
+  outb(PIC_MASTER_DATA, 0xff);
+  outb(PIC_SLAVE_DATA, 0xff);
+  profile_old_svr = *apic_reg(APIC_SVR);
+  *apic_reg(APIC_SVR) = APIC_SVR_ENABLE | PROFILE_SPURIOUS;
+
+  *apic_reg(APIC_TIMER_DIVIDE) = APIC_TIMER_DIVIDE_1;
+  *apic_reg(APIC_LVT_TIMER) = APIC_LVT_MASKED | PROFILE_VECTOR;
+  *apic_reg(APIC_TIMER_INIT) = ~0u;
+  wait(PROFILE_CALIBRATE_MS);
+  unsigned ticks = (~0u - *apic_reg(APIC_TIMER_CURRENT)) / PROFILE_CALIBRATE_MS;
+  *apic_reg(APIC_TIMER_INIT) = 0;
+
+  unsigned interval = ticks * 1000 / PROFILE_RATE;
+  *apic_reg(APIC_LVT_TIMER) = APIC_LVT_PERIODIC | PROFILE_VECTOR;
+  *apic_reg(APIC_TIMER_INIT) = interval ? interval : 1;
+  asm volatile ("sti");
+}
+
+
+/**
+ * Stop the timer, restore the previous state and print the samples.
+ */
+void
+profile_stop(void)
+{
+  if (!profile_apic)
+    return;
+  asm volatile ("cli");
+  *apic_reg(APIC_LVT_TIMER) = APIC_LVT_MASKED | PROFILE_VECTOR;
+  *apic_reg(APIC_TIMER_INIT) = 0;
+  *apic_reg(APIC_SVR) = profile_old_svr;
+  outb(PIC_MASTER_DATA, profile_old_pic[0]);
+  outb(PIC_SLAVE_DATA, profile_old_pic[1]);
+  asm volatile ("lidt %0" :: "m"(profile_old_idt));
+  profile_apic = 0;
+
+  out_char('\n');
+  for (unsigned i=0; i < profile_count; i++)
+    {
+      out_string("PROFILE ");
+      out_hex(profile_samples[i], 31);
+      out_char('\n');
+    }
+  if (profile_lost)
+    out_description("PROFILE samples lost:", profile_lost);
+}
+
+#endif
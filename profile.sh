@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Map the 'PROFILE <eip>' samples of a CONFIG_PROFILE build to the
+# symbols of the binary and print the functions by their share of
+# the samples, e.g.
+#
+#   profile.sh oslo serial.log
+#
+
+NM=${NM:-nm}
+
+if [ $# -ne 2 ]; then
+  echo "usage: $0 binary log" >&2
+  exit 2
+fi
+
+{
+  $NM -n "$1" | awk '$2 ~ /^[tTwW]$/ { print "S", $1, $3 }'
+  tr -d '\r' < "$2" | awk '$1 == "PROFILE" && NF == 2 { print "P", $2 }'
+} | awk '
+  function hex(s,    i, n) {
+    n = 0
+    for (i = 1; i <= length(s); i++)
+      n = n * 16 + index("0123456789ABCDEF", toupper(substr(s, i, 1))) - 1
+    return n
+  }
+  BEGIN { symbols = 0; samples = 0 }
+  $1 == "S" { addr[symbols] = hex($2); name[symbols++] = $3; next }
+  $1 == "P" {
+    eip = hex($2)
+    samples++
+    if (!symbols || eip < addr[0]) {
+      count["?"]++
+      next
+    }
+    # the last symbol at or below the eip
+    lo = 0; hi = symbols - 1
+    while (lo < hi) {
+      mid = int((lo + hi + 1) / 2)
+      if (addr[mid] <= eip)
+        lo = mid
+      else
+        hi = mid - 1
+    }
+    count[name[lo]]++
+  }
+  END {
+    if (!samples) {
+      print "no samples" > "/dev/stderr"
+      exit 1
+    }
+    for (f in count)
+      printf "%8d %6.2f%% %s\n", count[f], 100 * count[f] / samples, f
+  }' | sort -rn
@@ -0,0 +1,148 @@
+#!/bin/sh
+#
+# Boot OSLO binaries under QEMU with a swtpm TIS and print the time
+# and the TPM commands of every boot phase.  The binaries need the
+# serial console and the trace records, e.g.
+#
+#   make DEBUG=1 CONFIG=configs/bench.config qemu-bench
+#
+# QEMU loads the binary via multiboot with a fixed corpus of
+# synthetic modules.  A binary is stopped as soon as it printed its
+# records, which happens before skinit, before the next module is
+# started or on an error.  QEMU does not implement skinit, thus
+# OSLO measures the modules only in a configs/dryrun.config build.
+# A binary argument can carry a command line, e.g. 'staged beirut
+# pamplona'.
+#
+
+QEMU=${QEMU:-qemu-system-x86_64}
+SWTPM=${SWTPM:-swtpm}
+modules=4
+size=16777216
+kernel=
+tpm2=--tpm2
+timeout=120
+
+usage()
+{
+  echo "usage: $0 [-n modules] [-s size] [-k kernel] [-1] [-t seconds] binary..." >&2
+  echo "  -k  a linux kernel as first module, e.g. for munich" >&2
+  echo "  -1  emulate a TPM 1.2 instead of a TPM 2.0" >&2
+  exit 2
+}
+
+while getopts n:s:k:1t: opt; do
+  case $opt in
+    n) modules=$OPTARG ;;
+    s) size=$OPTARG ;;
+    k) kernel=$OPTARG ;;
+    1) tpm2= ;;
+    t) timeout=$OPTARG ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || usage
+
+dir=$(mktemp -d) || exit 1
+qemu_pid=
+swtpm_pid=
+trap 'kill $qemu_pid $swtpm_pid 2>/dev/null; rm -rf "$dir"' EXIT
+trap 'exit 1' INT TERM
+
+
+# the same modules for every run, so that the results are comparable
+mods=
+[ -n "$kernel" ] && mods="$kernel console=ttyS0"
+i=0
+while [ $i -lt "$modules" ]; do
+  yes "oslo bench module $i" | head -c "$size" > "$dir/module$i"
+  mods="$mods${mods:+,}$dir/module$i arg$i"
+  i=$((i + 1))
+done
+
+
+# evaluate the TRACE lines of trace.c
+report()
+{
+  tr -d '\r' | awk -v name="$1" '
+    function hex(s,    i, n) {
+      n = 0
+      for (i = 1; i <= length(s); i++)
+        n = n * 16 + index("0123456789ABCDEF", toupper(substr(s, i, 1))) - 1
+      return n
+    }
+    BEGIN { n = 0 }
+    $1 == "TRACE" && $2 == "calibrate" { khz = hex($4) / hex($3); next }
+    $1 == "TRACE" && $2 == "end" { exit }
+    $1 == "TRACE" && $2 == "pmc" { pmcs = NF - 2; for (j = 0; j < pmcs; j++) event[j] = $(j + 3); next }
+    $1 == "TRACE" && NF >= 4 {
+      tsc[n] = hex($2); cmds[n] = hex($3); phase[n] = $4
+      for (j = 0; j < pmcs; j++)
+        pmc[n, j] = hex($(j + 5))
+      n++
+    }
+    function line(label, a, b,    j) {
+      printf "%-16s %-10s %10.3f %8d", "", label, (tsc[b] - tsc[a]) / khz, cmds[b] - cmds[a]
+      for (j = 0; j < pmcs; j++)
+        printf " %14d", pmc[b, j] - pmc[a, j]
+      printf "\n"
+    }
+    END {
+      if (!n || !khz) {
+        printf "%s: no trace records\n", name
+        exit 1
+      }
+      printf "%-16s %-10s %10s %8s", name, "phase", "ms", "TPM cmds"
+      for (j = 0; j < pmcs; j++)
+        printf " %14s", event[j]
+      printf "\n"
+      for (i = 0; i + 1 < n; i++)
+        line(phase[i], i, i + 1)
+      line("total", 0, n - 1)
+      printf "\n"
+    }'
+}
+
+
+res=0
+for arg in "$@"; do
+  bin=${arg%% *}
+  rm -rf "$dir/tpm" "$dir/serial"
+  mkdir "$dir/tpm"
+
+  $SWTPM socket $tpm2 --tpmstate dir="$dir/tpm" --ctrl type=unixio,path="$dir/tpm/sock" --terminate &
+  swtpm_pid=$!
+  i=0
+  while [ ! -S "$dir/tpm/sock" ] && [ $i -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+
+  $QEMU -machine pc -cpu qemu64,+svm -m 1024 -display none -no-reboot -monitor none \
+	-serial file:"$dir/serial" \
+	-chardev socket,id=chrtpm,path="$dir/tpm/sock" \
+	-tpmdev emulator,id=tpm0,chardev=chrtpm -device tpm-tis,tpmdev=tpm0 \
+	-kernel "$bin" -append "$arg" -initrd "$mods" &
+  qemu_pid=$!
+
+  start=$(date +%s)
+  while kill -0 $qemu_pid 2>/dev/null && ! grep -q '^TRACE end' "$dir/serial" 2>/dev/null; do
+    if [ $(($(date +%s) - start)) -ge "$timeout" ]; then
+      echo "$arg: timeout" >&2
+      break
+    fi
+    sleep 0.1
+  done
+  kill $qemu_pid $swtpm_pid 2>/dev/null
+  wait $qemu_pid $swtpm_pid 2>/dev/null
+  qemu_pid=
+  swtpm_pid=
+
+  report "$arg" < "$dir/serial" || res=1
+  if grep -q '^PROFILE' "$dir/serial"; then
+    "$(dirname "$0")/profile.sh" "$bin" "$dir/serial" | head -20
+    echo
+  fi
+done
+exit $res
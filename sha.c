@@ -1,5 +1,5 @@
 /*
- * \brief   A size optimized SHA1 variant, hashes up to 512MB.
+ * \brief   A size optimized SHA1 variant, hashes up to 256GB.
  * \date    2006-03-28
  * \author  Bernhard Kauer <kauer@tudos.org>
  */
@@ -111,7 +111,6 @@ sha1(struct Context *ctx, unsigned char* value, unsigned count)
       memcpy(ctx->buffer + ctx->index, value, 64 - ctx->index);
       process_block(ctx);
       ctx->blocks++;
-      ERROR(-20, ctx->blocks>=1<<23, "more than 512 MB to hash");
     }
 
   memcpy(ctx->buffer + ctx->index, value, count);
@@ -136,9 +135,9 @@ sha1_finish(struct Context *ctx)
 	ctx->buffer[i]=0;
     }
   
-  /* using a 32bit value for blocks and not using the upper bits of
-     tmp limits the maximum hash size to 512 MB. */
-  unsigned long long tmp = (ctx->blocks << 9)+(ctx->index<<3);
-  ((unsigned long *) ctx->buffer)[15] = ntohl(tmp & 0xffffffff);
+  /* the length in bits, a 32bit value for blocks limits the maximum
+     hash size to 256 GB. */
+  ((unsigned *) ctx->buffer)[14] = ntohl(ctx->blocks >> 23);
+  ((unsigned *) ctx->buffer)[15] = ntohl((ctx->blocks << 9) + (ctx->index << 3));
   process_block(ctx);
 }
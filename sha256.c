@@ -0,0 +1,138 @@
+/*
+ * \brief   A size optimized SHA-256 for the TPM 2.0 PCR banks.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+
+#include "sha256.h"
+#include "util.h"
+
+
+#define ROR(VALUE, COUNT) ((VALUE)>>COUNT | (VALUE)<<(32-COUNT))
+
+static const unsigned int k[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+  };
+
+
+/**
+ * Process a single block of 512 bits.
+ */
+static
+void
+process_block(struct Sha256Context *ctx)
+{
+  unsigned int w[64];
+  unsigned int x[8];
+  unsigned int t1, t2;
+  unsigned i;
+
+  for (i=0; i<16; i++)
+    w[i] = ntohl(((unsigned int *) ctx->buffer)[i]);
+  for (; i<64; i++)
+    w[i] = w[i-16] + w[i-7]
+      + (ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3))
+      + (ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10));
+
+  for (i=0; i<8; i++)
+    x[i] = ctx->state[i];
+
+  for (i=0; i<64; i++)
+    {
+      t1 = x[7] + (ROR(x[4], 6) ^ ROR(x[4], 11) ^ ROR(x[4], 25))
+	+ ((x[4] & x[5]) ^ (~x[4] & x[6])) + k[i] + w[i];
+      t2 = (ROR(x[0], 2) ^ ROR(x[0], 13) ^ ROR(x[0], 22))
+	+ ((x[0] & x[1]) ^ (x[0] & x[2]) ^ (x[1] & x[2]));
+      for (int j=7; j>0; j--)
+	x[j] = x[j-1];
+      x[4] += t1;
+      x[0] = t1 + t2;
+    }
+
+  for (i=0; i<8; i++)
+    ctx->state[i] += x[i];
+}
+
+
+/**
+ * @param ctx    - store immediate values like unprocessed bytes and the overall length
+ */
+void
+sha256_init(struct Sha256Context *ctx)
+{
+  ctx->index = 0;
+  ctx->blocks = 0;
+  ctx->state[0] = 0x6a09e667;
+  ctx->state[1] = 0xbb67ae85;
+  ctx->state[2] = 0x3c6ef372;
+  ctx->state[3] = 0xa54ff53a;
+  ctx->state[4] = 0x510e527f;
+  ctx->state[5] = 0x9b05688c;
+  ctx->state[6] = 0x1f83d9ab;
+  ctx->state[7] = 0x5be0cd19;
+}
+
+
+/**
+ * Hash a count bytes from value.
+ *
+ * @param ctx    - store immediate values like unprocessed bytes and the overall length
+ * @param value  - a string to hash
+ * @param count  - the number of characters in value
+ */
+void
+sha256(struct Sha256Context *ctx, unsigned char* value, unsigned count)
+{
+  for (; count+ctx->index >= 64; count -= 64-ctx->index, value += 64-ctx->index, ctx->index = 0)
+    {
+      memcpy(ctx->buffer + ctx->index, value, 64 - ctx->index);
+      process_block(ctx);
+      ctx->blocks++;
+    }
+
+  memcpy(ctx->buffer + ctx->index, value, count);
+  ctx->index+= count;
+}
+
+
+/**
+ * Finish the operation. The output is available in ctx->hash.
+ */
+void
+sha256_finish(struct Sha256Context *ctx)
+{
+  ctx->buffer[ctx->index]=0x80;
+  for (unsigned i=ctx->index+1; i<64; i++)
+    ctx->buffer[i]=0;
+
+  if (ctx->index>55)
+    {
+      process_block(ctx);
+      for (unsigned i=0; i<64; i++)
+	ctx->buffer[i]=0;
+    }
+
+  // the length in bits, 32 bits of blocks are enough for 256 GB
+  ((unsigned *) ctx->buffer)[14] = ntohl(ctx->blocks >> 23);
+  ((unsigned *) ctx->buffer)[15] = ntohl((ctx->blocks << 9) + (ctx->index << 3));
+  process_block(ctx);
+
+  for (unsigned i=0; i<8; i++)
+    ((unsigned int *) ctx->hash)[i] = ntohl(ctx->state[i]);
+}
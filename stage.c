@@ -0,0 +1,136 @@
+/*
+ * \brief   Runs the stages selected on the command line in one image.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+#include "version.h"
+#include "util.h"
+#include "tis.h"
+#include "elf.h"
+#include "mem.h"
+#include "stage.h"
+#include "dev.h"
+#include "trace.h"
+
+const char *message_label = "STAGED: ";
+
+
+/**
+ * The stages linked into this image.
+ */
+static const struct stage stages[] = {
+#ifdef STAGE_BEIRUT
+  {"beirut",   "BEIRUT: ",   beirut,      STAGE_TPM},
+#endif
+#ifdef STAGE_PAMPLONA
+  {"pamplona", "PAMPLONA: ", pamplona,    0},
+#endif
+#ifdef STAGE_MUNICH
+  {"munich",   "MUNICH: ",   start_linux, STAGE_FINAL},
+#endif
+};
+
+
+/**
+ * Find a stage by the word at the start of a string.
+ */
+static
+const struct stage *
+stage_find(const char *word, unsigned len)
+{
+  for (unsigned i=0; i < sizeof(stages) / sizeof(*stages); i++)
+    {
+      const char *name = stages[i].name;
+      unsigned j;
+      for (j=0; j < len && name[j] == word[j]; j++)
+	;
+      if (j == len && !name[j])
+	return stages + i;
+    }
+  return 0;
+}
+
+
+/**
+ * Release the TPM and the DEV before leaving the image.  The next
+ * module or kernel knows about neither of them.
+ */
+static
+void
+stage_release(int tpm)
+{
+  if (tpm > 0)
+    ERROR(15, tis_deactivate_all(), "tis_deactivate failed");
+
+  // the next module does not know about the bitmap of PAMPLONA
+  if (dev_enabled())
+    ERROR(18, disable_dev_protection(), "DEV disable failed");
+}
+
+
+/**
+ * Run the stages given on the command line in order and start the
+ * next module afterwards. Serial, memory map and PCI table are
+ * shared; the TPM is accessed once for all stages that need it.  A
+ * final stage does not return, thus everything is released before.
+ */
+int
+__main(struct mbi *mbi, unsigned flags)
+{
+#ifndef NDEBUG
+  serial_init();
+#endif
+  trace("main");
+  out_info(VERSION " runs stages");
+  ERROR(10, !mbi || flags != MBI_MAGIC, "not loaded via multiboot");
+  ERROR(11, ~mbi->flags & MBI_FLAG_CMDLINE, "no stages given");
+  ERROR(12, mem_init(mbi), "could not parse the memory map");
+
+  int tpm = 0;
+  char *cmdline = (char *) mbi->cmdline;
+
+  // skip the image name
+  while (*cmdline && *cmdline != ' ')
+    cmdline++;
+  while (*cmdline)
+    {
+      while (*cmdline == ' ')
+	cmdline++;
+      unsigned len = 0;
+      while (cmdline[len] && cmdline[len] != ' ')
+	len++;
+      if (!len)
+	break;
+
+      const struct stage *stage = stage_find(cmdline, len);
+      ERROR(13, !stage, "unknown stage");
+      cmdline += len;
+
+      if (stage->flags & STAGE_TPM)
+	{
+	  if (!tpm)
+	    tpm = tis_init(TIS_BASE) && tis_access(TIS_LOCALITY_2, 0) ? 1 : -1;
+	  if (tpm < 0)
+	    continue;
+	}
+
+      if (stage->flags & STAGE_FINAL)
+	stage_release(tpm);
+
+      message_label = stage->label;
+      ERROR(14, stage->func(mbi), "stage failed");
+      message_label = "STAGED: ";
+    }
+
+  stage_release(tpm);
+  ERROR(16, start_module(mbi), "start module failed");
+  return 17;
+}
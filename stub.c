@@ -0,0 +1,208 @@
+/*
+ * \brief   The measured part of OSLO that measures the rest.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * skinit sends the whole SLB over the LPC bus to the TPM, which costs
+ * milliseconds per KB.  Therefore the SLB contains only this stub and
+ * the size optimized hashes, which hash the rest of OSLO on the CPU
+ * and extend PCR17 with it.  The stub does not depend on the TIS or
+ * CRB driver as they live outside the SLB.
+ */
+
+#include "util.h"
+#include "sha.h"
+#include "sha256.h"
+#include "tis.h"
+#include "crb.h"
+#include "osl.h"
+
+
+enum stub_constants
+  {
+    STUB_TIMEOUT = 1 << 24,
+    STUB_EXTEND_SIZE = 34,
+    STUB_EXTEND2_HEADER = 33,
+    STUB_EXTEND2_SIZE = 87,
+    STUB_RESPONSE_SIZE = 10,
+    STUB_BAD_TAG = 0x1e,
+  };
+
+
+/**
+ * Wait until (*reg & mask) == value.
+ */
+static
+int
+stub_wait(volatile unsigned char *reg, unsigned char mask, unsigned char value)
+{
+  for (unsigned i=0; i < STUB_TIMEOUT; i++)
+    if ((*reg & mask) == value)
+      return 0;
+  return 1;
+}
+
+
+#ifdef CONFIG_CRB
+/**
+ * A minimal CRB transmit in locality 2.
+ * Returns the TPM result or a value < 0 on errors.
+ */
+static
+int
+stub_crb(unsigned char *cmd, unsigned size)
+{
+  volatile struct crb_mmap *mmap = (struct crb_mmap *) (TIS_BASE + TIS_LOCALITY_2);
+  volatile unsigned char *buffer;
+  unsigned i;
+
+  mmap->loc_ctrl = CRB_LOC_CTRL_REQUEST;
+  if (stub_wait((volatile unsigned char *) &mmap->loc_sts, CRB_LOC_STS_GRANTED, CRB_LOC_STS_GRANTED))
+    return -1;
+  mmap->ctrl_req = CRB_CTRL_REQ_READY;
+  if (stub_wait((volatile unsigned char *) &mmap->ctrl_req, CRB_CTRL_REQ_READY, 0))
+    return -2;
+
+  buffer = (unsigned char *) mmap->cmd_laddr;
+  for (i=0; i < size; i++)
+    buffer[i] = cmd[i];
+  mmap->ctrl_start = CRB_CTRL_START;
+  if (stub_wait((volatile unsigned char *) &mmap->ctrl_start, CRB_CTRL_START, 0))
+    return -3;
+
+  buffer = (unsigned char *) mmap->rsp_laddr;
+  i = buffer[6] << 24 | buffer[7] << 16 | buffer[8] << 8 | buffer[9];
+  mmap->ctrl_req = CRB_CTRL_REQ_IDLE;
+  mmap->loc_ctrl = CRB_LOC_CTRL_RELINQUISH;
+  return i;
+}
+#endif
+
+
+/**
+ * A minimal transmit in locality 2.  The TIS FIFO is used unless the
+ * interface id reports a CRB.
+ * Returns the TPM result or a value < 0 on errors.
+ */
+static
+int
+stub_transmit(unsigned char *cmd, unsigned size)
+{
+  volatile struct tis_mmap *mmap = (struct tis_mmap *) (TIS_BASE + TIS_LOCALITY_2);
+  unsigned char res[STUB_RESPONSE_SIZE];
+  unsigned i;
+
+#ifdef CONFIG_CRB
+  if ((*(volatile unsigned *) (TIS_BASE + TPM_INTF_ID) & TPM_INTF_TYPE_MASK) == TPM_INTF_CRB)
+    return stub_crb(cmd, size);
+#endif
+
+  mmap->access = TIS_ACCESS_REQUEST;
+  if (stub_wait(&mmap->access, TIS_ACCESS_VALID | TIS_ACCESS_ACTIVE, TIS_ACCESS_VALID | TIS_ACCESS_ACTIVE))
+    return -1;
+  mmap->sts_base = TIS_STS_CMD_READY;
+  if (stub_wait(&mmap->sts_base, TIS_STS_CMD_READY, TIS_STS_CMD_READY))
+    return -2;
+
+  for (i=0; i < size; i++)
+    mmap->data_fifo = cmd[i];
+  if (stub_wait(&mmap->sts_base, TIS_STS_VALID, TIS_STS_VALID) || mmap->sts_base & TIS_STS_EXPECT)
+    return -3;
+  mmap->sts_base = TIS_STS_TPM_GO;
+
+  if (stub_wait(&mmap->sts_base, TIS_STS_VALID | TIS_STS_DATA_AVAIL, TIS_STS_VALID | TIS_STS_DATA_AVAIL))
+    return -4;
+  for (i=0; i < STUB_RESPONSE_SIZE && mmap->sts_base & TIS_STS_DATA_AVAIL; i++)
+    res[i] = mmap->data_fifo;
+  // drop the new PCR value or the session
+  while (mmap->sts_base & TIS_STS_DATA_AVAIL)
+    mmap->data_fifo;
+
+  mmap->sts_base = TIS_STS_CMD_READY;
+  mmap->access = TIS_ACCESS_ACTIVE;
+  if (i != STUB_RESPONSE_SIZE)
+    return -5;
+  return res[6] << 24 | res[7] << 16 | res[8] << 8 | res[9];
+}
+
+
+/**
+ * Extend PCR17 with a TPM_Extend.  A TPM 2.0 rejects it with a bad
+ * tag and gets a TPM2_PCR_Extend of the SHA1 and the SHA-256 bank
+ * instead, as nobody else may extend the rest of OSLO.  With banks of
+ * other hashes OSLO does not measure the modules later on.
+ * Returns 0 on success.
+ */
+static
+int
+stub_extend(unsigned char *sha1, unsigned char *sha256)
+{
+  unsigned char cmd[STUB_EXTEND2_SIZE] = {0, 0xc1, 0, 0, 0, STUB_EXTEND_SIZE, 0, 0, 0, 0x14, 0, 0, 0, 17};
+  unsigned i;
+  int res;
+
+  for (i=0; i < 20; i++)
+    cmd[14 + i] = sha1[i];
+  res = stub_transmit(cmd, STUB_EXTEND_SIZE);
+#ifdef CONFIG_TPM2
+  unsigned char cmd2[STUB_EXTEND2_HEADER] = {0x80, 0x02, 0, 0, 0, STUB_EXTEND2_SIZE, 0, 0, 0x01, 0x82, 0, 0, 0, 17,
+					     0, 0, 0, 9, 0x40, 0, 0, 9, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 4};
+  if (res != STUB_BAD_TAG)
+    return res;
+
+  // the SHA1 digest follows the header, the SHA-256 digest comes last
+  for (i=0; i < STUB_EXTEND2_HEADER; i++)
+    cmd[i] = cmd2[i];
+  for (i=0; i < 20; i++)
+    cmd[STUB_EXTEND2_HEADER + i] = sha1[i];
+  cmd[STUB_EXTEND2_SIZE - 34] = 0;
+  cmd[STUB_EXTEND2_SIZE - 33] = 0x0b;
+  for (i=0; i < 32; i++)
+    cmd[STUB_EXTEND2_SIZE - 32 + i] = sha256[i];
+  res = stub_transmit(cmd, STUB_EXTEND2_SIZE);
+#else
+  (void) sha256;
+#endif
+  return res;
+}
+
+
+/**
+ * Entered after skinit. Hash and measure the rest of OSLO before
+ * executing it.  If the measurement fails, we stop here as the rest
+ * could not be trusted anyway.
+ */
+void
+slb_stub(struct mbi *mbi)
+{
+  unsigned char *start = (unsigned char *) &__LOADER_END__;
+  unsigned size = &__OSLO_END__ - &__LOADER_END__;
+  struct Context ctx;
+  unsigned char *hash256 = 0;
+
+  sha1_init(&ctx);
+  sha1(&ctx, start, size);
+  sha1_finish(&ctx);
+#ifdef CONFIG_TPM2
+  struct Sha256Context ctx256;
+  sha256_init(&ctx256);
+  sha256(&ctx256, start, size);
+  sha256_finish(&ctx256);
+  hash256 = ctx256.hash;
+#endif
+  if (stub_extend(ctx.hash, hash256))
+    while (1)
+      asm volatile("cli; hlt");
+  oslo(mbi);
+  while (1)
+    asm volatile("cli; hlt");
+}
@@ -0,0 +1,198 @@
+/*
+ * \brief   A TCG event log in the crypto agile format.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * The log follows the TCG PC Client format: a SHA1 formatted Spec ID
+ * Event03 followed by TCG_PCR_EVENT2 entries.  Every event carries a
+ * SHA1 and, if the TPM has such a bank, a SHA-256 digest.  The log is handed
+ * to the next module as an additional multiboot module, behind a
+ * header with the module digests, the PCR values and the TIS info.
+ */
+
+#include "util.h"
+#include "mem.h"
+#include "tcglog.h"
+
+#ifdef CONFIG_TCGLOG
+
+
+static struct oslo_handoff *tcglog_handoff_header;
+static unsigned char *tcglog_start;
+static unsigned char *tcglog_pos;
+static unsigned char *tcglog_end;
+static unsigned tcglog_sha256;
+
+
+/**
+ * Append data to the log.  Overflows are dropped silently, as the
+ * size was calculated before.
+ */
+static
+void
+tcglog_put(const void *data, unsigned size)
+{
+  if (!tcglog_pos || tcglog_pos + size > tcglog_end)
+    return;
+  memcpy(tcglog_pos, data, size);
+  tcglog_pos += size;
+}
+
+
+static
+void
+tcglog_put_long(unsigned value)
+{
+  tcglog_put(&value, sizeof(value));
+}
+
+
+/**
+ * Allocate the hand-off header and the log with room for all modules
+ * and write the Spec ID event.  The memory allocator has to be
+ * initialized before.
+ */
+int
+tcglog_init(struct mbi *mbi, unsigned banks)
+{
+  struct oslo_handoff *h;
+  unsigned digests = sizeof(*h) + mbi->mods_count * 20;
+  unsigned size = digests + TCGLOG_BASE_SIZE;
+  struct module *m = (struct module *) mbi->mods_addr;
+  for (unsigned i=0; i < mbi->mods_count; i++, m++)
+    size += TCGLOG_EVENT_SIZE + strlen((char *) m->string) + 1;
+
+  CHECK3(-1, !(h = (struct oslo_handoff *) mem_alloc(size, 0)), "no memory for the event log");
+  memset(h, 0, digests);
+  h->magic = OSLO_HANDOFF_MAGIC;
+  h->version = OSLO_HANDOFF_VERSION;
+#ifdef CONFIG_DRYRUN
+  h->flags = OSLO_HANDOFF_DRYRUN;
+#endif
+  h->module_count = mbi->mods_count;
+  h->module_offset = sizeof(*h);
+  h->log_offset = digests;
+  tcglog_handoff_header = h;
+  tcglog_start = (unsigned char *) h + digests;
+  tcglog_pos = tcglog_start;
+  tcglog_end = (unsigned char *) h + size;
+
+  tcglog_sha256 = banks & TPM2_BANK_SHA256;
+  struct tcg_spec_id_event spec = { "Spec ID Event03", 0, 0, 2, 0, 1, tcglog_sha256 ? 2 : 1 };
+  struct tcg_pcr_event event = { 0, EV_NO_ACTION, {0}, sizeof(spec) + spec.algorithms * 4 + 1 };
+  tcglog_put(&event, sizeof(event));
+  tcglog_put(&spec, sizeof(spec));
+  tcglog_put_long(TPM_ALG_SHA1 | 20 << 16);
+  if (tcglog_sha256)
+    tcglog_put_long(TPM_ALG_SHA256 | 32 << 16);
+  tcglog_put("", 1);
+  return 0;
+}
+
+
+/**
+ * Write the header of an event up to the event size.
+ */
+static
+void
+tcglog_header(unsigned pcr, unsigned type, unsigned char *sha1, unsigned char *sha256, unsigned size)
+{
+  unsigned short alg = TPM_ALG_SHA1;
+  tcglog_put_long(pcr);
+  tcglog_put_long(type);
+  tcglog_put_long(tcglog_sha256 ? 2 : 1);
+  tcglog_put(&alg, sizeof(alg));
+  tcglog_put(sha1, 20);
+  if (tcglog_sha256)
+    {
+      alg = TPM_ALG_SHA256;
+      tcglog_put(&alg, sizeof(alg));
+      tcglog_put(sha256, 32);
+    }
+  tcglog_put_long(size);
+}
+
+
+/**
+ * Log an event with its digests.
+ */
+void
+tcglog_event(unsigned pcr, unsigned type, unsigned char *sha1, unsigned char *sha256, const void *data, unsigned size)
+{
+  tcglog_header(pcr, type, sha1, sha256, size);
+  tcglog_put(data, size);
+}
+
+
+/**
+ * Log the measurement of a module into a PCR, usually PCR19, together
+ * with its index, size and command line.  The digest is also stored
+ * in the hand-off header.
+ */
+void
+tcglog_module(unsigned pcr, unsigned index, struct module *m, unsigned char *sha1, unsigned char *sha256)
+{
+  struct oslo_handoff *h = tcglog_handoff_header;
+  if (h && index < h->module_count)
+    memcpy((unsigned char *) h + h->module_offset + index * 20, sha1, 20);
+
+  unsigned len = strlen((char *) m->string) + 1;
+  struct tcglog_module data = { index, m->mod_end - m->mod_start };
+
+  tcglog_header(pcr, EV_IPL, sha1, sha256, sizeof(data) + len);
+  tcglog_put(&data, sizeof(data));
+  tcglog_put((char *) m->string, len);
+}
+
+
+/**
+ * Hand the log to the next module by appending it as last multiboot
+ * module named OSLO_HANDOFF_NAME.  The header is completed with the
+ * final PCR values, if they could be read, and the TIS info.  The
+ * module list is copied, as there is no room for another entry.  The
+ * name is copied as well, since our image is overwritten by the next
+ * module.
+ */
+int
+tcglog_handoff(struct mbi *mbi, unsigned char *pcr17, unsigned char *pcr19)
+{
+  struct oslo_handoff *h = tcglog_handoff_header;
+  CHECK3(-1, !h, "no event log");
+  if (pcr17 && pcr19)
+    {
+      memcpy(h->pcr17, pcr17, sizeof(h->pcr17));
+      memcpy(h->pcr19, pcr19, sizeof(h->pcr19));
+      h->flags |= OSLO_HANDOFF_PCRS;
+    }
+  h->tis = tis_info;
+  h->log_size = tcglog_pos - tcglog_start;
+  h->size = tcglog_pos - (unsigned char *) h;
+
+  struct module *m;
+  unsigned size = (mbi->mods_count + 1) * sizeof(*m);
+  CHECK3(-2, !(m = (struct module *) mem_alloc(size + sizeof(OSLO_HANDOFF_NAME), 0)), "no memory for the modules");
+  memcpy(m, (char *) mbi->mods_addr, mbi->mods_count * sizeof(*m));
+  memcpy((char *) m + size, OSLO_HANDOFF_NAME, sizeof(OSLO_HANDOFF_NAME));
+
+  struct module *log = m + mbi->mods_count;
+  log->mod_start = (unsigned) h;
+  log->mod_end = (unsigned) tcglog_pos;
+  log->string = (unsigned) m + size;
+  log->reserved = 0;
+
+  mbi->mods_addr = (unsigned) m;
+  mbi->mods_count++;
+  out_description("hand-off size", h->size);
+  return 0;
+}
+
+#endif
@@ -1,20 +1,364 @@
+/*
+ * \brief   Host test and benchmark of the SHA implementations.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * A host program ('make test' and 'make bench').  Every backend is
+ * checked against the FIPS 180 example vectors and against a simple
+ * reference implementation with random data, random lengths and
+ * random chunking.  The benchmark reports cycles per byte for sizes
+ * from 1 byte up to 1 GB.
+ */
+
 #include <stdio.h>
-#include "sha1_min.h"
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+#include "sha.h"
+#include "sha256.h"
+
 
+const char *message_label = "TEST_SHA: ";
 
-int main()
+void
+out_string(const char *value)
 {
-  struct Context ctx;
-  unsigned char hash[20] ="12345678901234567890";
-  unsigned char buffer[1024];
-  int count=0;
+  fputs(value, stderr);
+}
+
+void
+__exit(unsigned status)
+{
+  exit(status);
+}
+
+
+#define ROL(VALUE, COUNT) ((VALUE)<<(COUNT) | (VALUE)>>(32-(COUNT)))
+#define ROR(VALUE, COUNT) ((VALUE)>>(COUNT) | (VALUE)<<(32-(COUNT)))
+
+
+/**
+ * Pad a message as both algorithms do and call the block function
+ * for every block.
+ */
+static
+void
+ref_blocks(const unsigned char *data, size_t len, void (*block)(unsigned *state, const unsigned char *p), unsigned *state)
+{
+  unsigned char last[128];
+  size_t i, rest = len % 64;
+  unsigned long long bits = (unsigned long long) len * 8;
+
+  for (i=0; i + 64 <= len; i += 64)
+    block(state, data + i);
+
+  memset(last, 0, sizeof(last));
+  memcpy(last, data + i, rest);
+  last[rest] = 0x80;
+  unsigned size = rest < 56 ? 64 : 128;
+  for (unsigned j=0; j < 8; j++)
+    last[size - 1 - j] = bits >> (j * 8);
+  block(state, last);
+  if (size == 128)
+    block(state, last + 64);
+}
+
+
+static
+unsigned
+ref_load(const unsigned char *p)
+{
+  return (unsigned) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+
+static
+void
+ref_store(unsigned *state, unsigned count, unsigned char *out)
+{
+  for (unsigned i=0; i < count * 4; i++)
+    out[i] = state[i / 4] >> (24 - (i % 4) * 8);
+}
+
+
+static
+void
+ref_sha1_block(unsigned *h, const unsigned char *p)
+{
+  unsigned w[80], a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+  for (unsigned i=0; i < 80; i++)
+    {
+      unsigned f, k;
+      w[i] = i < 16 ? ref_load(p + i * 4) : ROL(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+      if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5a827999; }
+      else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ed9eba1; }
+      else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+      else             { f = b ^ c ^ d;                   k = 0xca62c1d6; }
+      unsigned t = ROL(a, 5) + f + e + k + w[i];
+      e = d; d = c; c = ROL(b, 30); b = a; a = t;
+    }
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+
+static
+void
+ref_sha1(const unsigned char *data, size_t len, unsigned char *out)
+{
+  unsigned h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+  ref_blocks(data, len, ref_sha1_block, h);
+  ref_store(h, 5, out);
+}
+
+
+static const unsigned ref_k256[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+  };
+
+
+static
+void
+ref_sha256_block(unsigned *h, const unsigned char *p)
+{
+  unsigned w[64], v[8];
+
+  for (unsigned i=0; i < 64; i++)
+    w[i] = i < 16 ? ref_load(p + i * 4)
+      : w[i-16] + (ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3))
+      + w[i-7] + (ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10));
+  memcpy(v, h, sizeof(v));
+  for (unsigned i=0; i < 64; i++)
+    {
+      unsigned t1 = v[7] + (ROR(v[4], 6) ^ ROR(v[4], 11) ^ ROR(v[4], 25))
+	+ ((v[4] & v[5]) ^ (~v[4] & v[6])) + ref_k256[i] + w[i];
+      unsigned t2 = (ROR(v[0], 2) ^ ROR(v[0], 13) ^ ROR(v[0], 22))
+	+ ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+      memmove(v + 1, v, 7 * sizeof(*v));
+      v[4] += t1;
+      v[0] = t1 + t2;
+    }
+  for (unsigned i=0; i < 8; i++)
+    h[i] += v[i];
+}
+
 
-  sha1_init(&ctx, hash);
-  while (0<(count = read(0, buffer, sizeof(buffer))))
-    sha1(&ctx, buffer, count, 0, 0);
+static
+void
+ref_sha256(const unsigned char *data, size_t len, unsigned char *out)
+{
+  unsigned h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+  ref_blocks(data, len, ref_sha256_block, h);
+  ref_store(h, 8, out);
+}
+
+
+/**
+ * The backends feed the data in chunks of at most chunk bytes.
+ */
+static
+void
+oslo_sha1(const unsigned char *data, size_t len, size_t chunk, unsigned char *out)
+{
+  struct Context ctx;
+  sha1_init(&ctx);
+  for (size_t i=0; i < len; i += chunk)
+    sha1(&ctx, (unsigned char *) data + i, len - i < chunk ? len - i : chunk);
   sha1_finish(&ctx);
+  memcpy(out, ctx.hash, sizeof(ctx.hash));
+}
+
+
+static
+void
+oslo_sha256(const unsigned char *data, size_t len, size_t chunk, unsigned char *out)
+{
+  struct Sha256Context ctx;
+  sha256_init(&ctx);
+  for (size_t i=0; i < len; i += chunk)
+    sha256(&ctx, (unsigned char *) data + i, len - i < chunk ? len - i : chunk);
+  sha256_finish(&ctx);
+  memcpy(out, ctx.hash, sizeof(ctx.hash));
+}
+
+
+struct backend
+{
+  const char *name;
+  unsigned size;
+  void (*hash)(const unsigned char *data, size_t len, size_t chunk, unsigned char *out);
+  void (*ref)(const unsigned char *data, size_t len, unsigned char *out);
+  const char *vectors[4];
+};
+
+
+/**
+ * The FIPS 180 examples: "abc", the empty string, the 448 bit
+ * message and one million 'a'.
+ */
+static const struct backend backends[] =
+  {
+    { "sha1",   20, oslo_sha1,   ref_sha1,
+      { "a9993e364706816aba3e25717850c26c9cd0d89d",
+	"da39a3ee5e6b4b0d3255bfef95601890afd80709",
+	"84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+	"34aa973cd4c4daa4f61eeb2bdbad27316534016f" } },
+    { "sha256", 32, oslo_sha256, ref_sha256,
+      { "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+	"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+	"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+	"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" } },
+  };
+
+
+enum test_constants
+  {
+    MILLION = 1000000,
+    RANDOM_ROUNDS = 2000,
+    RANDOM_MAX = 20000,
+    BENCH_CYCLES = 1 << 27,
+  };
+
+
+static
+int
+check(const struct backend *b, const char *what, const unsigned char *hash, const char *expected)
+{
+  char hex[65];
+  for (unsigned i=0; i < b->size; i++)
+    sprintf(hex + i * 2, "%02x", hash[i]);
+  if (!strcmp(hex, expected))
+    return 0;
+  printf("%s: %s failed: %s expected %s\n", b->name, what, hex, expected);
+  return 1;
+}
+
+
+static
+int
+test_vectors(const struct backend *b, unsigned char *buffer)
+{
+  static const char *messages[] = { "abc", "", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq" };
+  unsigned char hash[32];
+  int res = 0;
+
+  for (unsigned i=0; i < 3; i++)
+    {
+      b->hash((const unsigned char *) messages[i], strlen(messages[i]), 64, hash);
+      res |= check(b, "vector", hash, b->vectors[i]);
+    }
+  memset(buffer, 'a', MILLION);
+  b->hash(buffer, MILLION, MILLION, hash);
+  res |= check(b, "million a", hash, b->vectors[3]);
+  b->hash(buffer, MILLION, 1, hash);
+  res |= check(b, "million a bytewise", hash, b->vectors[3]);
+  return res;
+}
+
+
+static
+int
+test_random(const struct backend *b, unsigned char *buffer)
+{
+  unsigned char hash[32], expected[32];
+  int res = 0;
+
+  for (unsigned i=0; i < RANDOM_ROUNDS && !res; i++)
+    {
+      size_t len = rand() % RANDOM_MAX;
+      size_t chunk = 1 + rand() % (i & 1 ? 128 : RANDOM_MAX);
+      for (size_t j=0; j < len; j++)
+	buffer[j] = rand();
+      b->hash(buffer, len, chunk, hash);
+      b->ref(buffer, len, expected);
+      if (memcmp(hash, expected, b->size))
+	{
+	  printf("%s: random test failed: len %zu chunk %zu\n", b->name, len, chunk);
+	  res = 1;
+	}
+    }
+  return res;
+}
+
+
+/**
+ * Hash every size repeatedly, doubling the rounds until the run is
+ * long enough to get a stable number, and print the cycles per byte.
+ */
+static
+void
+bench(const struct backend *b, unsigned char *buffer, size_t max)
+{
+  unsigned char hash[32];
+  for (size_t size = 1; size <= max; size *= 4)
+    {
+      size_t rounds = 1;
+      unsigned long long cycles;
+      while (1)
+	{
+	  unsigned long long start = __rdtsc();
+	  for (size_t i=0; i < rounds; i++)
+	    b->hash(buffer, size, size, hash);
+	  cycles = __rdtsc() - start;
+	  if (cycles >= BENCH_CYCLES)
+	    break;
+	  rounds *= 2;
+	}
+      printf("%-8s %11zu bytes %10.2f cycles/byte\n", b->name, size, (double) cycles / (rounds * size));
+      fflush(stdout);
+      if (size < max && size * 4 > max)
+	size = max / 4;
+    }
+}
+
+
+int
+main(int argc, char **argv)
+{
+  size_t max = 0;
+  int res = 0;
+
+  if (argc > 1 && !strcmp(argv[1], "-b"))
+    max = argc > 2 ? strtoull(argv[2], 0, 0) : 1 << 30;
+
+  size_t size = max > MILLION ? max : MILLION;
+  unsigned char *buffer = malloc(size);
+  if (!buffer)
+    {
+      printf("no memory for %zu bytes\n", size);
+      return 2;
+    }
+  memset(buffer, 0x5a, size);
 
-  for (unsigned i=0; i<20; i++)
-    printf("%02x", hash[i]);
-  printf(" - \n");
+  for (unsigned i=0; i < sizeof(backends) / sizeof(*backends); i++)
+    {
+      const struct backend *b = backends + i;
+      if (max)
+	bench(b, buffer, max);
+      else
+	{
+	  int failed = test_vectors(b, buffer) | test_random(b, buffer);
+	  printf("%s: %s\n", b->name, failed ? "FAILED" : "ok");
+	  res |= failed;
+	}
+    }
+  free(buffer);
+  return res;
 }
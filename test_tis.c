@@ -0,0 +1,866 @@
+/*
+ * \brief   Host simulator of a TIS TPM to test and measure tis.c and tpm.c.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * A host program ('make test').  The TIS registers at TIS_BASE are
+ * mapped without access rights, so every MMIO access of the driver
+ * faults.  The simulator then fills the page with the current
+ * register values, single steps the instruction and processes a
+ * write afterwards.  Thus the unmodified tis.c, tpm.c and the
+ * mbi_calc_hash() of osl.c run against a model of the ACCESS, STS,
+ * burst count and FIFO state machines of a TPM 1.2.  With '-2' the
+ * model answers the TPM 2.0 commands of tpm2.c instead and '-i crb'
+ * puts it behind the registers of a CRB, whose command buffer lies
+ * in ordinary memory as with a firmware TPM.
+ *
+ * Time is simulated: wait() and every MMIO access advance the clock
+ * and commands complete after a configurable duration.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include "osl.c"
+#include "crb.h"
+
+
+enum sim_constants
+  {
+    SIM_LOCALITIES = 5,
+    SIM_PAGE       = 0x1000,
+    SIM_FIFO_SIZE  = 1024,
+    SIM_BURST      = 32,
+    SIM_PCRS       = 24,
+    SIM_EFLAGS_TF  = 0x100,
+    SIM_ERR_WRITE  = 0x2,
+    SIM_TIS_ID     = 0xffffffff,
+    SIM_INTF_CAP   = 0x5,
+    SIM_ALG_SHA384 = 0x0c,
+    TPM_BADTAG     = 0x1e,
+    TPM_BAD_ORDINAL= 0x0a,
+    TPM2_RC_HASH   = 0x83,
+    TPM2_RC_VALUE  = 0x84,
+    TPM2_RC_COMMAND_CODE = 0x143,
+  };
+
+
+enum sim_state
+  {
+    SIM_IDLE,
+    SIM_READY,
+    SIM_RECEPTION,
+    SIM_EXECUTION,
+    SIM_COMPLETION,
+  };
+
+
+struct sim_vendor
+{
+  const char *name;
+  unsigned did_vid;
+  unsigned char rid;
+  int atmel_bug;
+  enum tis_init expected;
+};
+
+
+static const struct sim_vendor vendors[] =
+  {
+    { "infineon", 0xb15d1,     0x10, 0, TIS_INIT_INFINEON },
+    { "stm",      0x4a100000,  0x01, 0, TIS_INIT_STM },
+    { "atmel",    0x32021114,  0x26, 1, TIS_INIT_ATMEL },
+    { "broadcom", 0x100214e4,  0x01, 0, TIS_INIT_BROADCOM },
+    { "qemu",     0x10001,     0x01, 0, TIS_INIT_QEMU },
+  };
+
+
+static struct
+{
+  const struct sim_vendor *vendor;
+  unsigned command_us;
+  unsigned extend_us;
+  unsigned mmio_us;
+  int tpm2;
+  unsigned sha384;
+  int crb;
+
+  int active;
+  int locality0_seen;
+  int started;
+  enum sim_state state;
+  unsigned char fifo[SIM_FIFO_SIZE];
+  unsigned len;
+  unsigned pos;
+  unsigned expected;
+  unsigned long long done;
+  unsigned char pcrs[SIM_PCRS][20];
+  unsigned char pcrs256[SIM_PCRS][32];
+  unsigned char *crb_buffer;
+
+  unsigned long long now;
+  unsigned long commands;
+  unsigned long reads;
+  unsigned long writes;
+
+  unsigned char *page;
+  unsigned locality;
+  unsigned offset;
+  int write;
+} sim;
+
+
+/**
+ * The console and helper functions of the target.
+ */
+int
+out_char(unsigned value)
+{
+  return putchar(value);
+}
+
+void
+out_string(const char *value)
+{
+  fputs(value, stdout);
+}
+
+void
+out_hex(unsigned value, unsigned bitlen)
+{
+  printf("%0*x", (bitlen + 4) / 4, value);
+}
+
+void
+out_description(const char *prefix, unsigned int value)
+{
+  printf("%s%s %x\n", message_label, prefix, value);
+}
+
+void
+out_info(const char *msg)
+{
+  printf("%s%s\n", message_label, msg);
+}
+
+void
+wait(int ms)
+{
+  sim.now += ms * 1000ULL;
+}
+
+void
+__exit(unsigned status)
+{
+  printf("exit %x\n", status);
+  exit(1);
+}
+
+int check_cpuid(void)                   { return -1; }
+int enable_svm(void)                    { return -1; }
+int send_ipi(unsigned param)            { (void) param; return -1; }
+int start_module(struct mbi *mbi)       { (void) mbi; return -1; }
+void do_skinit(void)                    { exit(1); }
+int mem_init(struct mbi *mbi)           { (void) mbi; return 0; }
+#ifdef CONFIG_MTRR
+int mtrr_set_wb(unsigned base, unsigned size) { (void) base; (void) size; return 0; }
+void mtrr_restore(void)                 {}
+#endif
+#ifdef CONFIG_TCGLOG
+int tcglog_init(struct mbi *mbi, unsigned banks) { (void) mbi; (void) banks; return -1; }
+void tcglog_event(unsigned pcr, unsigned type, unsigned char *sha1, unsigned char *sha256, const void *data, unsigned size)
+{ (void) pcr; (void) type; (void) sha1; (void) sha256; (void) data; (void) size; }
+void tcglog_module(unsigned pcr, unsigned index, struct module *m, unsigned char *sha1, unsigned char *sha256)
+{ (void) pcr; (void) index; (void) m; (void) sha1; (void) sha256; }
+int tcglog_handoff(struct mbi *mbi, unsigned char *pcr17, unsigned char *pcr19)
+{ (void) mbi; (void) pcr17; (void) pcr19; return -1; }
+#endif
+char __LOADER_START__, __LOADER_END__, __OSLO_END__;
+
+
+static
+unsigned
+sim_get(unsigned char *p)
+{
+  return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+
+static
+void
+sim_put(unsigned char *p, unsigned value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+
+/**
+ * Execute a TPM 2.0 command in the FIFO and put the response there.
+ * Only the commands sent by tpm2.c are known.
+ */
+static
+void
+sim_execute_tpm2(unsigned tag)
+{
+  unsigned cc = sim_get(sim.fifo + 6);
+  unsigned pcr = sim_get(sim.fifo + 10);
+  unsigned rc = 0;
+  unsigned char *p;
+
+  sim.len = 10;
+  switch (cc)
+    {
+    case TPM_CC_Startup:
+      rc = sim.started ? TPM_RC_INITIALIZE : 0;
+      sim.started = 1;
+      break;
+    case TPM_CC_SelfTest:
+      break;
+    case TPM_CC_GetCapability:
+      // moreData, the capability and all PCRs in a SHA1, a SHA-256 and maybe a SHA-384 bank
+      p = sim.fifo + 10;
+      *p++ = 0;
+      sim_put(p, TPM_CAP_PCRS);
+      sim_put(p + 4, 2 + sim.sha384);
+      p += 8;
+      for (unsigned i=0; i < 2 + sim.sha384; i++, p += 6)
+	{
+	  p[0] = 0;
+	  p[1] = i > 1 ? SIM_ALG_SHA384 : i ? TPM_ALG_SHA256 : TPM_ALG_SHA1;
+	  p[2] = 3;
+	  p[3] = p[4] = p[5] = 0xff;
+	}
+      sim.len = p - sim.fifo;
+      break;
+    case TPM_CC_PCR_Extend:
+      if (tag != TPM_ST_SESSIONS || pcr >= SIM_PCRS)
+	{
+	  rc = TPM2_RC_VALUE;
+	  break;
+	}
+      // skip the authorization area
+      p = sim.fifo + 18 + sim_get(sim.fifo + 14);
+      for (unsigned count = sim_get(p), i=0; i < count && !rc; i++)
+	{
+	  unsigned alg = p[4] << 8 | p[5];
+	  if (alg == TPM_ALG_SHA1)
+	    {
+	      struct Context ctx;
+	      sha1_init(&ctx);
+	      sha1(&ctx, sim.pcrs[pcr], 20);
+	      sha1(&ctx, p + 6, 20);
+	      sha1_finish(&ctx);
+	      memcpy(sim.pcrs[pcr], ctx.hash, 20);
+	      p += 22;
+	    }
+	  else if (alg == TPM_ALG_SHA256)
+	    {
+	      struct Sha256Context ctx;
+	      sha256_init(&ctx);
+	      sha256(&ctx, sim.pcrs256[pcr], 32);
+	      sha256(&ctx, p + 6, 32);
+	      sha256_finish(&ctx);
+	      memcpy(sim.pcrs256[pcr], ctx.hash, 32);
+	      p += 34;
+	    }
+	  else
+	    rc = TPM2_RC_HASH;
+	}
+      // an empty parameter area and password session
+      memset(sim.fifo + 10, 0, 9);
+      sim.len += 9;
+      break;
+    case TPM_CC_PCR_Read:
+      {
+	unsigned alg = sim.fifo[14] << 8 | sim.fifo[15];
+	unsigned size = alg == TPM_ALG_SHA256 ? 32 : 20;
+	unsigned select = sim.fifo[17] | sim.fifo[18] << 8 | sim.fifo[19] << 16;
+	if (sim_get(sim.fifo + 10) != 1 || sim.fifo[16] != 3 || (alg != TPM_ALG_SHA1 && alg != TPM_ALG_SHA256))
+	  {
+	    rc = TPM2_RC_VALUE;
+	    break;
+	  }
+
+	// the update counter, the selection and at most 8 values
+	memmove(sim.fifo + 14, sim.fifo + 10, 10);
+	sim_put(sim.fifo + 10, sim.commands);
+	unsigned count = 0;
+	p = sim.fifo + 28;
+	for (unsigned i=0; i < SIM_PCRS && count < 8; i++)
+	  if (select & (1 << i))
+	    {
+	      p[0] = 0;
+	      p[1] = size;
+	      memcpy(p + 2, alg == TPM_ALG_SHA256 ? sim.pcrs256[i] : sim.pcrs[i], size);
+	      p += 2 + size;
+	      count++;
+	    }
+	sim_put(sim.fifo + 24, count);
+	sim.len = p - sim.fifo;
+      }
+      break;
+    default:
+      rc = TPM2_RC_COMMAND_CODE;
+    }
+  if (rc)
+    {
+      tag = TPM_ST_NO_SESSIONS;
+      sim.len = 10;
+    }
+  sim.fifo[0] = tag >> 8;
+  sim.fifo[1] = tag;
+  sim_put(sim.fifo + 2, sim.len);
+  sim_put(sim.fifo + 6, rc);
+  sim.pos = 0;
+}
+
+
+/**
+ * Execute the command in the FIFO and put the response there.  A
+ * TPM 2.0 answers TPM 1.2 commands with a bad tag.
+ */
+static
+void
+sim_execute(void)
+{
+  unsigned tag = sim.fifo[0] << 8 | sim.fifo[1];
+  unsigned ordinal = sim_get(sim.fifo + 6);
+  unsigned pcr = sim_get(sim.fifo + 10);
+  unsigned rc = 0;
+
+  sim.commands++;
+  if (sim.tpm2 && tag != 0xc1)
+    {
+      sim_execute_tpm2(tag);
+      return;
+    }
+  sim.len = 10;
+  if (tag != 0xc1 || sim.tpm2)
+    rc = TPM_BADTAG;
+  else
+    switch (ordinal)
+      {
+      case TPM_ORD_Extend:
+	if (pcr >= SIM_PCRS)
+	  {
+	    rc = 3;
+	    break;
+	  }
+	struct Context ctx;
+	sha1_init(&ctx);
+	sha1(&ctx, sim.pcrs[pcr], 20);
+	sha1(&ctx, sim.fifo + 14, 20);
+	sha1_finish(&ctx);
+	memcpy(sim.pcrs[pcr], ctx.hash, 20);
+	/* fall through */
+      case TPM_ORD_PcrRead:
+	if (pcr >= SIM_PCRS)
+	  {
+	    rc = 3;
+	    break;
+	  }
+	memcpy(sim.fifo + 10, sim.pcrs[pcr], 20);
+	sim.len += 20;
+	break;
+      case TPM_ORD_Startup:
+	rc = sim.started ? 0x26 : 0;
+	sim.started = 1;
+	break;
+      case TPM_ORD_ContinueSelfTest:
+	break;
+      case TPM_ORD_GetCapability:
+	sim_put(sim.fifo + 10, 4);
+	sim_put(sim.fifo + 14, SIM_PCRS);
+	sim.len += 8;
+	break;
+      default:
+	rc = TPM_BAD_ORDINAL;
+      }
+  sim.fifo[0] = 0;
+  sim.fifo[1] = 0xc4;
+  sim_put(sim.fifo + 2, sim.len);
+  sim_put(sim.fifo + 6, rc);
+  sim.pos = 0;
+}
+
+
+/**
+ * The duration of the command in the FIFO.
+ */
+static
+unsigned long long
+sim_duration(void)
+{
+  unsigned ordinal = sim_get(sim.fifo + 6);
+  return ordinal == TPM_ORD_Extend || ordinal == TPM_CC_PCR_Extend ? sim.extend_us : sim.command_us;
+}
+
+
+/**
+ * The status register, which also completes a command when its time
+ * has come.
+ */
+static
+unsigned char
+sim_status(unsigned locality)
+{
+  if ((int) locality != sim.active)
+    return 0xff;
+  if (sim.state == SIM_EXECUTION && sim.now >= sim.done)
+    {
+      sim_execute();
+      sim.state = SIM_COMPLETION;
+    }
+  unsigned char res = TIS_STS_VALID;
+  if (sim.state == SIM_READY)
+    res |= TIS_STS_CMD_READY;
+  if (sim.state == SIM_COMPLETION && sim.pos < sim.len)
+    res |= TIS_STS_DATA_AVAIL;
+  if (sim.state == SIM_RECEPTION && (sim.len < 6 || sim.len < sim.expected))
+    res |= TIS_STS_EXPECT;
+  return res;
+}
+
+
+/**
+ * Fill a page with the register values before the driver reads
+ * it.  Only a read of the FIFO has a side effect.
+ */
+static
+void
+sim_fill(unsigned locality, unsigned char *page, int read)
+{
+  unsigned did_vid = sim.vendor->did_vid;
+  unsigned burst = sim.state == SIM_COMPLETION ? sim.len - sim.pos : SIM_BURST;
+
+  if (sim.vendor->atmel_bug && !sim.locality0_seen)
+    did_vid = 0xffffffff;
+  page[0x00] = TIS_ACCESS_VALID | ((int) locality == sim.active ? TIS_ACCESS_ACTIVE : 0);
+  *(unsigned *) (page + 0x14) = SIM_INTF_CAP;
+  page[0x18] = sim_status(locality);
+  page[0x19] = burst;
+  page[0x1a] = burst >> 8;
+  page[0x24] = 0xff;
+  if (read && (int) locality == sim.active && sim.state == SIM_COMPLETION && sim.pos < sim.len)
+    page[0x24] = sim.fifo[sim.pos++];
+  *(unsigned *) (page + TPM_INTF_ID) = SIM_TIS_ID;
+  *(unsigned *) (page + TPM_DID_VID_0) = did_vid;
+  page[TPM_DID_VID_0 + 4] = sim.vendor->rid;
+}
+
+
+/**
+ * Process a byte written by the driver.
+ */
+static
+void
+sim_write(unsigned locality, unsigned offset, unsigned char value)
+{
+  switch (offset)
+    {
+    case 0x00:
+      if (value & (TIS_ACCESS_REQUEST | TIS_ACCESS_TO_SEIZE))
+	{
+	  if (sim.active < 0 || value & TIS_ACCESS_TO_SEIZE)
+	    sim.active = locality;
+	  if (!locality)
+	    sim.locality0_seen = 1;
+	}
+      if (value & TIS_ACCESS_ACTIVE && sim.active == (int) locality)
+	sim.active = -1;
+      break;
+    case 0x18:
+      if ((int) locality != sim.active)
+	break;
+      if (value & TIS_STS_CMD_READY)
+	{
+	  sim.state = SIM_READY;
+	  sim.len = sim.pos = sim.expected = 0;
+	}
+      if (value & TIS_STS_TPM_GO && sim.state == SIM_RECEPTION && sim.len == sim.expected)
+	{
+	  sim.done = sim.now + sim_duration();
+	  sim.state = SIM_EXECUTION;
+	}
+      break;
+    case 0x24:
+      if ((int) locality != sim.active || (sim.state != SIM_READY && sim.state != SIM_RECEPTION) || sim.len >= SIM_FIFO_SIZE)
+	break;
+      sim.state = SIM_RECEPTION;
+      sim.fifo[sim.len++] = value;
+      if (sim.len == 6)
+	sim.expected = sim_get(sim.fifo + 2);
+      break;
+    default:
+      break;
+    }
+}
+
+
+/**
+ * Fill a page with the CRB register values.  A command completes
+ * when the driver polls the registers after its duration and the
+ * response replaces it in the buffer.
+ */
+static
+void
+sim_crb_fill(unsigned locality, unsigned char *page)
+{
+  struct crb_mmap *crb = (struct crb_mmap *) page;
+
+  if (sim.state == SIM_EXECUTION && sim.now >= sim.done)
+    {
+      sim_execute();
+      memcpy(sim.crb_buffer, sim.fifo, sim.len);
+      sim.state = SIM_COMPLETION;
+    }
+  crb->loc_state = CRB_LOC_STATE_VALID | (sim.active >= 0 ? CRB_LOC_STATE_ASSIGNED | sim.active << 2 : 0);
+  crb->loc_sts = (int) locality == sim.active ? CRB_LOC_STS_GRANTED : 0;
+  crb->intf_id = TPM_INTF_CRB | sim.vendor->rid << 24;
+  crb->did_vid = sim.vendor->did_vid;
+  crb->ctrl_req = 0;
+  crb->ctrl_sts = 0;
+  crb->ctrl_start = sim.state == SIM_EXECUTION;
+  crb->cmd_size = crb->rsp_size = SIM_FIFO_SIZE;
+  crb->cmd_laddr = crb->rsp_laddr = (unsigned long) sim.crb_buffer;
+  crb->cmd_haddr = crb->rsp_haddr = 0;
+}
+
+
+/**
+ * Process a CRB register written by the driver.
+ */
+static
+void
+sim_crb_write(unsigned locality, unsigned offset, unsigned value)
+{
+  switch (offset)
+    {
+    case offsetof(struct crb_mmap, loc_ctrl):
+      if (value & (CRB_LOC_CTRL_REQUEST | CRB_LOC_CTRL_SEIZE) && (sim.active < 0 || value & CRB_LOC_CTRL_SEIZE))
+	sim.active = locality;
+      if (value & CRB_LOC_CTRL_RELINQUISH && sim.active == (int) locality)
+	sim.active = -1;
+      break;
+    case offsetof(struct crb_mmap, ctrl_req):
+      if ((int) locality != sim.active)
+	break;
+      if (value & CRB_CTRL_REQ_READY)
+	sim.state = SIM_READY;
+      if (value & CRB_CTRL_REQ_IDLE)
+	sim.state = SIM_IDLE;
+      break;
+    case offsetof(struct crb_mmap, ctrl_start):
+      if ((int) locality != sim.active || !(value & CRB_CTRL_START) || sim.state != SIM_READY)
+	break;
+      memcpy(sim.fifo, sim.crb_buffer, SIM_FIFO_SIZE);
+      sim.done = sim.now + sim_duration();
+      sim.state = SIM_EXECUTION;
+      break;
+    default:
+      break;
+    }
+}
+
+
+/**
+ * An MMIO access faulted: prepare the page and single step.
+ */
+static
+void
+sim_segv(int sig, siginfo_t *info, void *context)
+{
+  ucontext_t *uc = context;
+  unsigned long addr = (unsigned long) info->si_addr;
+  unsigned base = TIS_BASE;
+
+  (void) sig;
+  if (addr < base || addr >= base + SIM_LOCALITIES * SIM_PAGE)
+    {
+      signal(SIGSEGV, SIG_DFL);
+      return;
+    }
+  sim.locality = (addr - base) / SIM_PAGE;
+  sim.offset = addr % SIM_PAGE;
+  sim.page = (unsigned char *) (addr & ~(SIM_PAGE - 1UL));
+  sim.write = uc->uc_mcontext.gregs[REG_ERR] & SIM_ERR_WRITE;
+  sim.now += sim.mmio_us;
+  if (sim.write)
+    sim.writes++;
+  else
+    sim.reads++;
+
+  mprotect(sim.page, SIM_PAGE, PROT_READ | PROT_WRITE);
+  if (sim.crb)
+    sim_crb_fill(sim.locality, sim.page);
+  else
+    sim_fill(sim.locality, sim.page, !sim.write && sim.offset == 0x24);
+  uc->uc_mcontext.gregs[REG_EFL] |= SIM_EFLAGS_TF;
+}
+
+
+/**
+ * The instruction was executed: process a write and protect the
+ * page again.
+ */
+static
+void
+sim_trap(int sig, siginfo_t *info, void *context)
+{
+  ucontext_t *uc = context;
+
+  (void) sig;
+  (void) info;
+  uc->uc_mcontext.gregs[REG_EFL] &= ~SIM_EFLAGS_TF;
+  if (sim.write && sim.crb)
+    sim_crb_write(sim.locality, sim.offset & ~3, *(unsigned *) (sim.page + (sim.offset & ~3)));
+  else if (sim.write)
+    sim_write(sim.locality, sim.offset, sim.page[sim.offset]);
+  mprotect(sim.page, SIM_PAGE, PROT_NONE);
+}
+
+
+static
+void
+sim_init(void)
+{
+  struct sigaction sa;
+  unsigned base = TIS_BASE;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_flags = SA_SIGINFO;
+  sa.sa_sigaction = sim_segv;
+  sigaction(SIGSEGV, &sa, 0);
+  sa.sa_sigaction = sim_trap;
+  sigaction(SIGTRAP, &sa, 0);
+
+  if (mmap((void *) (unsigned long) base, SIM_LOCALITIES * SIM_PAGE, PROT_NONE,
+	   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *) (unsigned long) base)
+    {
+      perror("mmap TIS");
+      exit(2);
+    }
+  sim.active = -1;
+}
+
+
+/**
+ * Allocate modules below 4G as the mbi holds 32-bit pointers.
+ */
+static
+void *
+sim_alloc(unsigned size)
+{
+  void *res = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+  if (res == MAP_FAILED)
+    {
+      perror("mmap");
+      exit(2);
+    }
+  return res;
+}
+
+
+static
+double
+sim_wall(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+static
+void
+usage(const char *name)
+{
+  printf("usage: %s [-v vendor] [-2] [-i fifo|crb] [-m modules] [-s size] [-c command_us] [-e extend_us] [-l mmio_us]\n"
+	 "vendors:", name);
+  for (unsigned i=0; i < sizeof(vendors) / sizeof(*vendors); i++)
+    printf(" %s", vendors[i].name);
+  printf("\n");
+  exit(2);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  unsigned modules = 8, size = 1 << 20;
+  int opt;
+
+  sim.vendor = vendors;
+  sim.command_us = 1000;
+  sim.extend_us = 5000;
+  sim.mmio_us = 1;
+  while ((opt = getopt(argc, argv, "v:2i:m:s:c:e:l:")) != -1)
+    switch (opt)
+      {
+      case 'v':
+	sim.vendor = 0;
+	for (unsigned i=0; i < sizeof(vendors) / sizeof(*vendors); i++)
+	  if (!strcmp(optarg, vendors[i].name))
+	    sim.vendor = vendors + i;
+	if (!sim.vendor)
+	  usage(argv[0]);
+	break;
+      case '2': sim.tpm2 = 1; break;
+      case 'i':
+	if (strcmp(optarg, "fifo") && strcmp(optarg, "crb"))
+	  usage(argv[0]);
+	sim.crb = !strcmp(optarg, "crb");
+	break;
+      case 'm': modules = strtoul(optarg, 0, 0); break;
+      case 's': size = strtoul(optarg, 0, 0); break;
+      case 'c': sim.command_us = strtoul(optarg, 0, 0); break;
+      case 'e': sim.extend_us = strtoul(optarg, 0, 0); break;
+      case 'l': sim.mmio_us = strtoul(optarg, 0, 0); break;
+      default: usage(argv[0]);
+      }
+  if (!modules)
+    usage(argv[0]);
+  // only a TPM 2.0 has a CRB
+  if (sim.crb)
+    {
+      sim.tpm2 = 1;
+      sim.crb_buffer = sim_alloc(SIM_FIFO_SIZE);
+    }
+
+  sim_init();
+  message_label = "TEST_TIS: ";
+
+  // the multiboot modules
+  struct mbi *mbi = sim_alloc(sizeof(*mbi));
+  struct module *m = sim_alloc(modules * sizeof(*m));
+  mbi->flags = MBI_FLAG_MODS;
+  mbi->mods_count = modules;
+  mbi->mods_addr = (unsigned long) m;
+  for (unsigned i=0; i < modules; i++)
+    {
+      unsigned char *p = sim_alloc(size + 1);
+      for (unsigned j=0; j < size; j++)
+	p[j] = i * 13 + j;
+      m[i].mod_start = (unsigned long) p;
+      m[i].mod_end = m[i].mod_start + size;
+      m[i].string = (unsigned long) "module";
+    }
+
+  int res = 0;
+  enum tis_init expected = sim.vendor->expected;
+#ifndef CONFIG_TIS_VENDORS
+  expected = TIS_INIT_GENERIC;
+#endif
+#ifndef CONFIG_TIS_ATMEL_FIX
+  // without the fix the broken DID/VID register looks like no TPM
+  if (sim.vendor->atmel_bug)
+    expected = TIS_INIT_NO_TPM;
+#endif
+  enum tis_init vendor = tis_init(TIS_BASE);
+  if (vendor != expected)
+    {
+      printf("FAILED: tis_init() returned %d instead of %d\n", vendor, expected);
+      res = 1;
+    }
+  tis_deactivate_all();
+  if (!tis_access(TIS_LOCALITY_2, 0))
+    {
+      printf("FAILED: no access to locality 2\n");
+      return 1;
+    }
+
+  unsigned char buffer[TPM2_BUFFER_SIZE];
+  unsigned char pcrs[40];
+  struct Context ctx;
+  struct Sha256Context ctx256;
+  if (!tpm2_detect(buffer) != !sim.tpm2)
+    {
+      printf("FAILED: tpm2_detect() returned the wrong TPM family\n");
+      return 1;
+    }
+
+  unsigned long long start = sim.now;
+  unsigned long commands = sim.commands, reads = sim.reads, writes = sim.writes;
+  double wall = sim_wall();
+  if (mbi_calc_hash(mbi, buffer, &ctx, &ctx256) || read_pcrs(buffer, pcrs))
+    {
+      printf("FAILED: mbi_calc_hash()\n");
+      return 1;
+    }
+  wall = sim_wall() - wall;
+
+  // the expected PCR19 values
+  unsigned char pcr19[20], pcr19_256[32];
+  memset(pcr19, 0, sizeof(pcr19));
+  memset(pcr19_256, 0, sizeof(pcr19_256));
+  for (unsigned i=0; i < modules; i++)
+    {
+      unsigned char digest[32];
+      sha1_init(&ctx);
+      sha1(&ctx, (unsigned char *) (unsigned long) m[i].mod_start, size);
+      sha1_finish(&ctx);
+      memcpy(digest, ctx.hash, 20);
+      sha1_init(&ctx);
+      sha1(&ctx, pcr19, 20);
+      sha1(&ctx, digest, 20);
+      sha1_finish(&ctx);
+      memcpy(pcr19, ctx.hash, 20);
+
+      sha256_init(&ctx256);
+      sha256(&ctx256, (unsigned char *) (unsigned long) m[i].mod_start, size);
+      sha256_finish(&ctx256);
+      memcpy(digest, ctx256.hash, 32);
+      sha256_init(&ctx256);
+      sha256(&ctx256, pcr19_256, 32);
+      sha256(&ctx256, digest, 32);
+      sha256_finish(&ctx256);
+      memcpy(pcr19_256, ctx256.hash, 32);
+    }
+  if (memcmp(pcr19, pcrs + 20, 20) || memcmp(pcr19, sim.pcrs[19], 20))
+    {
+      printf("FAILED: PCR19 differs\n");
+      res = 1;
+    }
+  unsigned char values[32];
+  if (sim.tpm2 && (tpm2_pcr_read(buffer, 1 << 19, TPM_ALG_SHA256, values) != 1
+		   || memcmp(pcr19_256, values, 32) || memcmp(pcr19_256, sim.pcrs256[19], 32)))
+    {
+      printf("FAILED: SHA-256 PCR19 differs\n");
+      res = 1;
+    }
+
+  printf("%s%s%s: %u modules of %u bytes: %lu TPM commands, %lu MMIO reads, %lu MMIO writes, %.3f ms simulated, %.3f ms wall\n",
+	 sim.vendor->name, sim.tpm2 ? " tpm2" : "", sim.crb ? " crb" : "", modules, size, sim.commands - commands, sim.reads - reads, sim.writes - writes,
+	 (sim.now - start) / 1000.0, wall);
+
+  // a bank we cannot extend keeps the modules unmeasured
+  sim.sha384 = sim.tpm2;
+  if (sim.tpm2 && tpm2_detect(buffer) >= 0)
+    {
+      printf("FAILED: tpm2_detect() accepted a SHA-384 bank\n");
+      res = 1;
+    }
+  tis_deactivate_all();
+  printf("%s\n", res ? "FAILED" : "ok");
+  return res;
+}
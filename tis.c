@@ -15,17 +15,79 @@
 
 #include "util.h"
 #include "tis.h"
+#include "crb.h"
+#include "trace.h"
 
 
 /**
  * TIS base address.
  */
-static int tis_base;
+static unsigned tis_base;
 
 /**
  * Address of the TIS locality.
  */
-static int tis_locality;
+static unsigned tis_locality;
+
+#ifdef CONFIG_CRB
+/**
+ * Is the TPM behind a CRB instead of a FIFO?
+ */
+static int tis_crb;
+#else
+enum { tis_crb = 0 };
+#endif
+
+
+/**
+ * The identification and timeouts of the TPM.
+ */
+struct tis_info tis_info;
+
+
+/**
+ * Find out which TPM vendor we have.
+ * Returns a TIS_INIT_* value.
+ */
+static
+enum tis_init
+tis_vendor(int did_vid, unsigned char rid)
+{
+  switch (did_vid)
+    {
+#ifdef CONFIG_TIS_VENDORS
+    case 0x2e4d5453:   /* "STM." */
+    case 0x4a100000:
+      out_description("STM rev:", rid);
+      return TIS_INIT_STM;
+    case 0xb15d1:
+      out_description("Infineon rev:", rid);
+      return TIS_INIT_INFINEON;
+    case 0x32021114:
+    case 0x32031114:
+      out_description("Atmel rev:", rid);
+      return TIS_INIT_ATMEL;
+    case 0x100214E4:
+      out_description("Broadcom rev:", rid);
+      return TIS_INIT_BROADCOM;
+    case 0x10001:
+      out_description("Qemu TPM rev:", rid);
+      return TIS_INIT_QEMU;
+#endif
+    case 0:
+    case -1:
+      out_info("TPM not found!");
+      return TIS_INIT_NO_TPM;
+    default:
+      out_description("TPM unknown! ID:",did_vid);
+#ifdef CONFIG_TIS_VENDORS
+      return TIS_INIT_NO_TPM;
+#else
+      (void) rid;
+      return TIS_INIT_GENERIC;
+#endif
+    }
+}
 
 
 /**
@@ -33,7 +95,7 @@ static int tis_locality;
  * Returns a TIS_INIT_* value.
  */
 enum tis_init
-tis_init(int base)
+tis_init(unsigned base)
 {
   volatile struct tis_id *id;
   volatile struct tis_mmap *mmap;
@@ -41,46 +103,46 @@ tis_init(int base)
   tis_base = base;
   id = (struct tis_id *)(tis_base + TPM_DID_VID_0);
   mmap = (struct tis_mmap *)(tis_base);
+  tis_info.interface = *(volatile unsigned int *)(tis_base + TPM_INTF_ID) & TPM_INTF_TYPE_MASK;
+#ifdef CONFIG_CRB
+  tis_crb = tis_info.interface == TPM_INTF_CRB;
+#endif
 
+#ifdef CONFIG_TIS_ATMEL_FIX
   /**
    * There are these buggy ATMEL TPMs that return -1 as did_vid if the
    * locality0 is not accessed!
    */
-  if ((id->did_vid == -1)
+  if (!tis_crb && (id->did_vid == -1)
       && ((mmap->intf_capability & ~0x1fa) == 5)
       && ((mmap->access & 0xe8) == 0x80))
     {
       out_info("Fix DID/VID bug...");
       tis_access(TIS_LOCALITY_0, 0);
     }
+#endif
 
-  switch (id->did_vid)
+#ifdef CONFIG_CRB
+  if (tis_crb)
     {
-    case 0x2e4d5453:   /* "STM." */
-    case 0x4a100000:
-      out_description("STM rev:", id->rid);
-      return TIS_INIT_STM;
-    case 0xb15d1:
-      out_description("Infineon rev:", id->rid);
-      return TIS_INIT_INFINEON;
-    case 0x32021114:
-    case 0x32031114:
-      out_description("Atmel rev:", id->rid);
-      return TIS_INIT_ATMEL;
-    case 0x100214E4:
-      out_description("Broadcom rev:", id->rid);
-      return TIS_INIT_BROADCOM;
-    case 0x10001:
-      out_description("Qemu TPM rev:", id->rid);
-      return TIS_INIT_QEMU;
-    case 0:
-    case -1:
-      out_info("TPM not found!");
-      return TIS_INIT_NO_TPM;
-    default:
-      out_description("TPM unknown! ID:",id->did_vid);
-      return TIS_INIT_NO_TPM;
+      volatile struct crb_mmap *crb = (struct crb_mmap *)(tis_base);
+      out_info("CRB interface");
+      tis_info.did_vid = crb->did_vid;
+      tis_info.rid = crb->intf_id >> 24;
+      tis_info.intf_capability = crb->intf_id;
     }
+  else
+#endif
+    {
+      tis_info.did_vid = id->did_vid;
+      tis_info.rid = id->rid;
+      tis_info.intf_capability = mmap->intf_capability;
+    }
+  tis_info.timeout_a = TIS_TIMEOUT_A;
+  tis_info.timeout_b = TIS_TIMEOUT_B;
+  tis_info.timeout_c = TIS_TIMEOUT_C;
+  tis_info.timeout_d = TIS_TIMEOUT_D;
+  return tis_info.vendor = tis_vendor(tis_info.did_vid, tis_info.rid);
 }
 
 
@@ -93,6 +155,8 @@ tis_deactivate_all(void)
 {
   int res = 0;
   unsigned i;
+  if (tis_crb)
+    return crb_deactivate_all(tis_base);
   for (i=0; i<4; i++)
     {
       volatile struct tis_mmap *mmap = (struct tis_mmap *)(tis_base+(i<<12));
@@ -121,6 +185,8 @@ tis_access(int locality, int force)
   assert(locality>=TIS_LOCALITY_0 && locality <= TIS_LOCALITY_4);
 
   tis_locality = tis_base + locality;
+  if (tis_crb)
+    return crb_access(tis_locality, force);
   mmap = (struct tis_mmap *) tis_locality;
 
   CHECK3(0, !(mmap->access & TIS_ACCESS_VALID), "access register not valid");
@@ -153,7 +219,7 @@ void
 wait_state(volatile struct tis_mmap *mmap, unsigned char state)
 {
   unsigned i;
-  for (i=0; i<750 && (mmap->sts_base & state)!=state; i++)
+  for (i=0; i<TIS_TIMEOUT_C && (mmap->sts_base & state)!=state; i++)
     wait(1);
 }
 
@@ -217,18 +283,53 @@ tis_read(unsigned char *buffer, unsigned int size)
 
 
 /**
- * Transmit a command to the TPM and wait for the response.
- * This is our high level TIS function used by all TPM commands.
+ * Send a command to the TPM without waiting for the response.  This
+ * allows to overlap a slow command with other work.
+ * Returns the number of bytes sent or a value < 0 on errors.
  */
 int
-tis_transmit(const unsigned char *write_buffer, unsigned write_count, unsigned char *read_buffer, unsigned read_count)
+tis_transmit_start(const unsigned char *write_buffer, unsigned write_count)
 {
-  unsigned int res;
+  int res;
 
+#ifdef CONFIG_TRACE
+  trace_tpm_commands++;
+#endif
+  if (tis_crb)
+    return crb_transmit_start(tis_locality, write_buffer, write_count);
   res = tis_write(write_buffer, write_count);
   CHECK4(-1, res<=0, "  TIS write error:",res);
+  return res;
+}
+
+
+/**
+ * Wait for the response of a command sent by tis_transmit_start().
+ * Returns the number of bytes received or a value < 0 on errors.
+ */
+int
+tis_transmit_finish(unsigned char *read_buffer, unsigned read_count)
+{
+  int res;
 
+  if (tis_crb)
+    return crb_transmit_finish(tis_locality, read_buffer, read_count);
   res = tis_read(read_buffer, read_count);
   CHECK4(-2, res<=0, "  TIS read error:",res);
   return res;
 }
+
+
+/**
+ * Transmit a command to the TPM and wait for the response.
+ * This is our high level TIS function used by all TPM commands.
+ */
+int
+tis_transmit(const unsigned char *write_buffer, unsigned write_count, unsigned char *read_buffer, unsigned read_count)
+{
+  int res;
+
+  if ((res = tis_transmit_start(write_buffer, write_count)) < 0)
+    return res;
+  return tis_transmit_finish(read_buffer, read_count);
+}
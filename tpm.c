@@ -23,7 +23,7 @@
  * Note: We could use the TPM_TRANSMIT_FUNC macro, but this generates smaller code.
  */
 int
-TPM_Startup_Clear(unsigned char *buffer)
+TPM_Startup_Clear(unsigned char buffer[TCG_BUFFER_SIZE])
 {
   ((unsigned int *)buffer)[0] = 0x0000c100;
   ((unsigned int *)buffer)[1] = 0x00000c00;
@@ -32,13 +32,38 @@ TPM_Startup_Clear(unsigned char *buffer)
   return res < 0 ? res : (int) ntohl(*((unsigned int *) (buffer+6)));
 }
 
+/**
+ * Start a TPM_ContinueSelfTest without waiting for its result, which
+ * is collected with TPM_Finish().
+ */
+int
+TPM_ContinueSelfTest_Start(unsigned char buffer[TCG_BUFFER_SIZE])
+{
+  ((unsigned int *)buffer)[0] = 0x0000c100;
+  ((unsigned int *)buffer)[1] = 0x00000a00;
+  ((unsigned short *)buffer)[4] = 0x5300;
+  return tis_transmit_start(buffer, 10);
+}
+
+
+/**
+ * Wait for the result of a command started before.
+ */
+int
+TPM_Finish(unsigned char *buffer, unsigned size)
+{
+  int res = tis_transmit_finish(buffer, size);
+  return res < 0 ? res : (int) ntohl(*((unsigned int *) (buffer+6)));
+}
+
+
 /**
  * Extend a PCR with a hash.
  *
  * Note: We could use the TPM_TRANSMIT_FUNC macro, but this generates smaller code.
  */
 int
-TPM_Extend(unsigned char *buffer, unsigned long pcrindex, unsigned char *hash)
+TPM_Extend(unsigned char buffer[TCG_BUFFER_SIZE], unsigned long pcrindex, unsigned char *hash)
 {
   ((unsigned int *)buffer)[0] = 0x0000c100;
   ((unsigned int *)buffer)[1] = 0x00002200;
@@ -50,12 +75,23 @@ TPM_Extend(unsigned char *buffer, unsigned long pcrindex, unsigned char *hash)
   return res < 0 ? res : (int) ntohl(*((unsigned int *) (buffer+6)));
 }
 
+/**
+ * Read a pcr value.
+ * Returns the value of the pcr in pcrvalue.
+ */
+TPM_TRANSMIT_FUNC(PcrRead,
+		  (unsigned char buffer[TCG_BUFFER_SIZE], unsigned long index, unsigned char *value),
+		  unsigned int send_buffer[] = {TPM_ORD_PcrRead AND index};
+		  if (value==0) return -1;,
+		  TPM_COPY_FROM(value, 0, TCG_HASH_SIZE);)
+
+
 #ifndef NDEBUG
 /*
  * Get the number of suported pcrs.
  */
-TPM_TRANSMIT_FUNC(GetCapability_Pcrs, (unsigned char *buffer, unsigned int *value),
-		  unsigned long send_buffer[] = { TPM_ORD_GetCapability
+TPM_TRANSMIT_FUNC(GetCapability_Pcrs, (unsigned char buffer[TCG_BUFFER_SIZE], unsigned int *value),
+		  unsigned int send_buffer[] = { TPM_ORD_GetCapability
 		      AND TPM_CAP_PROPERTY
 		      AND TPM_SUBCAP AND TPM_CAP_PROP_PCR };,
 		  if (TPM_EXTRACT_LONG(0)!=4)
@@ -63,18 +99,7 @@ TPM_TRANSMIT_FUNC(GetCapability_Pcrs, (unsigned char *buffer, unsigned int *valu
 		  *value=TPM_EXTRACT_LONG(4);)
 
 
-/**
- * Read a pcr value.
- * Returns the value of the pcr in pcrvalue.
- */
-TPM_TRANSMIT_FUNC(PcrRead,
-		  (unsigned char *buffer, unsigned long index, unsigned char *value),
-		  unsigned long send_buffer[] = {TPM_ORD_PcrRead AND index};
-		  if (value==0) return -1;,
-		  TPM_COPY_FROM(value, 0, TCG_HASH_SIZE);)
-
-
-
+#ifdef CONFIG_DEBUG_PCRS
 void
 dump_pcrs(unsigned char *buffer)
 {
@@ -106,3 +131,4 @@ dump_pcrs(unsigned char *buffer)
     }
 }
 #endif
+#endif
@@ -0,0 +1,281 @@
+/*
+ * \brief   TPM commands compiled with the TCG TPM 2.0 Library Spec.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * Commands are built in the transmit buffer with big endian fields of
+ * variable size.  A TPM 1.2 answers them with its own response tag,
+ * which is used to find out the TPM family.
+ */
+
+#include "util.h"
+#include "tpm2.h"
+
+#ifdef CONFIG_TPM2
+
+
+unsigned tpm2_banks;
+
+
+/**
+ * Store a big endian value of size bytes.
+ */
+static
+unsigned char *
+tpm2_put(unsigned char *p, unsigned value, unsigned size)
+{
+  while (size--)
+    *p++ = value >> (size * 8);
+  return p;
+}
+
+
+/**
+ * Load a big endian value of size bytes.
+ */
+static
+unsigned
+tpm2_get(unsigned char *p, unsigned size)
+{
+  unsigned value = 0;
+  while (size--)
+    value = value << 8 | *p++;
+  return value;
+}
+
+
+/**
+ * Start a command in the buffer.
+ * Returns the position of the parameters.
+ */
+static
+unsigned char *
+tpm2_header(unsigned char *buffer, unsigned tag, unsigned cc)
+{
+  buffer = tpm2_put(buffer, tag, 2);
+  return tpm2_put(buffer + 4, cc, 4);
+}
+
+
+/**
+ * Fill in the size and send the command that ends at end.
+ */
+static
+int
+tpm2_send(unsigned char *buffer, unsigned char *end)
+{
+  tpm2_put(buffer + 2, end - buffer, 4);
+  return tis_transmit_start(buffer, end - buffer);
+}
+
+
+/**
+ * Wait for the response of a command.
+ * Returns the response code or a value < 0 on errors.
+ */
+int
+tpm2_finish(unsigned char *buffer)
+{
+  int res = tis_transmit_finish(buffer, TPM2_BUFFER_SIZE);
+  if (res < 0)
+    return res;
+  CHECK4(-2, res < TPM2_HEADER_SIZE, "TPM2 response too short", res);
+  if (tpm2_get(buffer, 2) != TPM_ST_NO_SESSIONS && tpm2_get(buffer, 2) != TPM_ST_SESSIONS)
+    return TPM2_NOT_A_TPM2;
+  return tpm2_get(buffer + 6, 4);
+}
+
+
+/**
+ * Transmit the command that ends at end.
+ * Returns the response code or a value < 0 on errors.
+ */
+static
+int
+tpm2_transmit(unsigned char *buffer, unsigned char *end)
+{
+  int res;
+  if ((res = tpm2_send(buffer, end)) < 0)
+    return res;
+  return tpm2_finish(buffer);
+}
+
+
+/**
+ * Start a TPM2_Startup(CLEAR), the result is collected with
+ * tpm2_finish().
+ */
+int
+tpm2_startup_start(unsigned char *buffer)
+{
+  unsigned char *p = tpm2_header(buffer, TPM_ST_NO_SESSIONS, TPM_CC_Startup);
+  return tpm2_send(buffer, tpm2_put(p, TPM_SU_CLEAR, 2));
+}
+
+
+/**
+ * Send a TPM2_Startup(CLEAR).
+ */
+int
+tpm2_startup(unsigned char *buffer)
+{
+  int res;
+  if ((res = tpm2_startup_start(buffer)) < 0)
+    return res;
+  return tpm2_finish(buffer);
+}
+
+
+/**
+ * Start a TPM2_SelfTest of all algorithms that were not tested yet,
+ * the result is collected with tpm2_finish().
+ */
+int
+tpm2_selftest_start(unsigned char *buffer)
+{
+  unsigned char *p = tpm2_header(buffer, TPM_ST_NO_SESSIONS, TPM_CC_SelfTest);
+  return tpm2_send(buffer, tpm2_put(p, 0, 1));
+}
+
+
+/**
+ * Ask the TPM for its PCR banks.
+ * Returns the TPM2_BANK_* bits of all banks with PCRs allocated or a
+ * value < 0 on errors.  Banks of other hashes set TPM2_BANK_OTHER.
+ */
+int
+tpm2_get_banks(unsigned char *buffer)
+{
+  int res;
+  unsigned char *p = tpm2_header(buffer, TPM_ST_NO_SESSIONS, TPM_CC_GetCapability);
+  p = tpm2_put(p, TPM_CAP_PCRS, 4);
+  p = tpm2_put(p, 0, 4);
+  p = tpm2_put(p, 1, 4);
+  if ((res = tpm2_transmit(buffer, p)))
+    return res < 0 ? res : -res;
+
+  // skip moreData and the capability
+  p = buffer + TPM2_HEADER_SIZE + 5;
+  unsigned banks = 0;
+  for (unsigned count = tpm2_get(p, 4), i = 0; i < count && p < buffer + TPM2_BUFFER_SIZE - 7; i++)
+    {
+      unsigned alg = tpm2_get(p + 4, 2);
+      unsigned size = p[6];
+      unsigned selected = 0;
+      for (unsigned j=0; j < size; j++)
+	selected |= p[7 + j];
+      if (selected)
+	banks |= alg == TPM_ALG_SHA1 ? TPM2_BANK_SHA1 : alg == TPM_ALG_SHA256 ? TPM2_BANK_SHA256 : TPM2_BANK_OTHER;
+      p += 3 + size;
+    }
+  return banks;
+}
+
+
+/**
+ * Find out whether we talk to a TPM 2.0 and which banks it has.
+ * Returns the banks, zero for a TPM 1.2 or a value < 0 if a bank
+ * uses a hash we cannot compute.  Such a bank would not cover the
+ * modules, thus the callers do not measure at all.
+ */
+int
+tpm2_detect(unsigned char *buffer)
+{
+  int banks = tpm2_get_banks(buffer);
+  tpm2_banks = banks > 0 ? banks & ~TPM2_BANK_OTHER : 0;
+  if (tpm2_banks)
+    out_description("TPM 2.0 banks:", banks);
+  CHECK3(-1, banks > 0 && banks & TPM2_BANK_OTHER, "unsupported PCR bank");
+  return tpm2_banks;
+}
+
+
+/**
+ * Extend a PCR in all given banks with a single command.
+ */
+int
+tpm2_pcr_extend(unsigned char *buffer, unsigned pcr, unsigned banks, unsigned char *sha1, unsigned char *sha256)
+{
+  unsigned char *p = tpm2_header(buffer, TPM_ST_SESSIONS, TPM_CC_PCR_Extend);
+  p = tpm2_put(p, pcr, 4);
+
+  // an empty password session
+  p = tpm2_put(p, 9, 4);
+  p = tpm2_put(p, TPM_RS_PW, 4);
+  p = tpm2_put(p, 0, 4);
+  p = tpm2_put(p, 0, 1);
+
+  p = tpm2_put(p, !!(banks & TPM2_BANK_SHA1) + !!(banks & TPM2_BANK_SHA256), 4);
+  if (banks & TPM2_BANK_SHA1)
+    {
+      p = tpm2_put(p, TPM_ALG_SHA1, 2);
+      memcpy(p, sha1, 20);
+      p += 20;
+    }
+  if (banks & TPM2_BANK_SHA256)
+    {
+      p = tpm2_put(p, TPM_ALG_SHA256, 2);
+      memcpy(p, sha256, 32);
+      p += 32;
+    }
+  return tpm2_transmit(buffer, p);
+}
+
+
+/**
+ * Read the given PCRs of a bank with a single command.  The values
+ * are stored one after the other in ascending PCR order.
+ * Returns the number of values read or a value < 0 on errors.
+ */
+int
+tpm2_pcr_read(unsigned char *buffer, unsigned pcrs, unsigned alg, unsigned char *values)
+{
+  int res;
+  unsigned char *p = tpm2_header(buffer, TPM_ST_NO_SESSIONS, TPM_CC_PCR_Read);
+  p = tpm2_put(p, 1, 4);
+  p = tpm2_put(p, alg, 2);
+  p = tpm2_put(p, 3, 1);
+  p = tpm2_put(p, pcrs, 1);
+  p = tpm2_put(p, pcrs >> 8, 1);
+  p = tpm2_put(p, pcrs >> 16, 1);
+  if ((res = tpm2_transmit(buffer, p)))
+    return res < 0 ? res : -res;
+
+  // skip the update counter and our selection
+  p = buffer + TPM2_HEADER_SIZE + 4 + 10;
+  unsigned count = tpm2_get(p, 4);
+  p += 4;
+  for (unsigned i=0; i < count; i++)
+    {
+      unsigned size = tpm2_get(p, 2);
+      CHECK3(-4, p + 2 + size > buffer + TPM2_BUFFER_SIZE, "TPM2 PCR values too large");
+      memcpy(values, p + 2, size);
+      values += size;
+      p += 2 + size;
+    }
+  return count;
+}
+
+
+/**
+ * Extend a PCR on a TPM 1.2 or on all known banks of a TPM 2.0.
+ * Note: On a TPM 1.2 the new PCR value is returned in sha1.
+ */
+int
+tpm_extend(unsigned char *buffer, unsigned pcr, unsigned char *sha1, unsigned char *sha256)
+{
+  if (tpm2_banks)
+    return tpm2_pcr_extend(buffer, pcr, tpm2_banks, sha1, sha256);
+  return TPM_Extend(buffer, pcr, sha1);
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * \brief   Timestamps of the boot phases for benchmarks.
+ * \date    2026-10-19
+ * \author  the OSLO contributors
+ */
+/*
+ * Copyright (C) 2026  the OSLO contributors
+ *
+ * This file is part of the OSLO package, which is distributed under
+ * the  terms  of the  GNU General Public Licence 2.  Please see the
+ * COPYING file for details.
+ */
+
+/**
+ * Every phase records the TSC and the number of TPM commands sent so
+ * far.  With CONFIG_TRACE_PMC, the core performance counters of AMD
+ * processors count cycles, instructions, L2 misses and uncached
+ * requests as well, which separates memory from MMIO stalls.  The
+ * last two events exist only from family 10h to 16h and are left out
+ * on other processors.  The records are printed only once before the
+ * next module is started, so that the slow console does not disturb
+ * the measurement.  The lines have the form
+ *
+ *   TRACE calibrate <ms> <TSC ticks in these ms>
+ *   TRACE pmc <names of the counted events>
+ *   TRACE <TSC> <TPM commands> <phase> [<counter values>]
+ *   TRACE end
+ *
+ * with hex numbers and are evaluated by qemu_bench.sh.  The
+ * profiler of CONFIG_PROFILE runs from the first record until they
+ * are printed.
+ */
+
+#include "asm.h"
+#include "util.h"
+#include "trace.h"
+#include "profile.h"
+
+#ifdef CONFIG_TRACE
+
+unsigned trace_tpm_commands;
+
+static struct trace_record
+{
+  const char *phase;
+  unsigned long long tsc;
+  unsigned commands;
+#ifdef CONFIG_TRACE_PMC
+  unsigned long long pmc[TRACE_PMCS];
+#endif
+} trace_records[TRACE_RECORDS];
+static unsigned trace_count;
+
+
+#ifdef CONFIG_TRACE_PMC
+static const unsigned trace_events[TRACE_PMCS] = { PMC_CYCLES, PMC_INSTRUCTIONS, PMC_L2_MISSES, PMC_UNCACHED };
+static const char *trace_event_names[TRACE_PMCS] = { "cycles", "instructions", "l2_misses", "uncached" };
+
+/**
+ * The number of programmed counters. Negative on other vendors.
+ */
+static int trace_pmc;
+
+
+/**
+ * Start the counters in the first phase.  Other vendors do not have
+ * these MSRs and newer families encode the L2 and UC events
+ * differently.
+ */
+static
+void
+trace_pmc_start(void)
+{
+  trace_pmc = -1;
+  if (cpuid_ebx(0) != CPUID_EBX_AMD)
+    return;
+  unsigned family = (cpuid_eax(1) >> 8) & 0xf;
+  if (family == 0xf)
+    family += (cpuid_eax(1) >> 20) & 0xff;
+  trace_pmc = family >= PMC_FAMILY_FIRST && family <= PMC_FAMILY_LAST ? TRACE_PMCS : TRACE_PMCS_COMMON;
+  for (int i=0; i < trace_pmc; i++)
+    {
+      wrmsr(MSR_PERF_CTL0 + i, 0);
+      wrmsr(MSR_PERF_CTR0 + i, 0);
+      wrmsr(MSR_PERF_CTL0 + i, trace_events[i] | PERF_CTL_USR | PERF_CTL_OS | PERF_CTL_EN);
+    }
+}
+
+
+/**
+ * Stop the counters, so that the next module finds them unused.
+ */
+static
+void
+trace_pmc_stop(void)
+{
+  for (int i=0; i < trace_pmc; i++)
+    wrmsr(MSR_PERF_CTL0 + i, 0);
+  trace_pmc = 0;
+}
+#endif
+
+
+/**
+ * Record the begin of a phase.
+ */
+void
+trace(const char *phase)
+{
+  if (trace_count >= TRACE_RECORDS)
+    return;
+  if (!trace_count)
+    profile_start();
+  trace_records[trace_count].phase = phase;
+  trace_records[trace_count].commands = trace_tpm_commands;
+#ifdef CONFIG_TRACE_PMC
+  if (!trace_pmc)
+    trace_pmc_start();
+  for (int i=0; i < trace_pmc; i++)
+    trace_records[trace_count].pmc[i] = rdmsr(MSR_PERF_CTR0 + i);
+#endif
+  trace_records[trace_count++].tsc = rdtsc();
+}
+
+
+static
+void
+trace_hex64(unsigned long long value)
+{
+  out_hex(value >> 32, 31);
+  out_hex(value, 31);
+}
+
+
+/**
+ * Print all records and the TSC ticks of a PIT interval.
+ */
+void
+trace_dump(void)
+{
+  profile_stop();
+
+  unsigned long long tsc = rdtsc();
+  wait(TRACE_CALIBRATE_MS);
+  tsc = rdtsc() - tsc;
+
+  out_string("\nTRACE calibrate ");
+  out_hex(TRACE_CALIBRATE_MS, 0);
+  out_char(' ');
+  trace_hex64(tsc);
+  out_char('\n');
+#ifdef CONFIG_TRACE_PMC
+  if (trace_pmc > 0)
+    {
+      out_string("TRACE pmc");
+      for (int j=0; j < trace_pmc; j++)
+	{
+	  out_char(' ');
+	  out_string(trace_event_names[j]);
+	}
+      out_char('\n');
+    }
+#endif
+  for (unsigned i=0; i < trace_count; i++)
+    {
+      out_string("TRACE ");
+      trace_hex64(trace_records[i].tsc);
+      out_char(' ');
+      out_hex(trace_records[i].commands, 31);
+      out_char(' ');
+      out_string(trace_records[i].phase);
+#ifdef CONFIG_TRACE_PMC
+      for (int j=0; j < trace_pmc; j++)
+	{
+	  out_char(' ');
+	  trace_hex64(trace_records[i].pmc[j]);
+	}
+#endif
+      out_char('\n');
+    }
+  out_string("TRACE end\n");
+  trace_count = 0;
+#ifdef CONFIG_TRACE_PMC
+  trace_pmc_stop();
+#endif
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include "util.h"
+#include "trace.h"
 
 /**
  * Wait roughly a given number of milliseconds.
@@ -51,6 +52,7 @@ wait(int ms)
 void
 __exit(unsigned status)
 {
+  trace_dump();
   out_char('\n');
   out_description("exit()", status);
   for (unsigned i=0; i<16;i++)
@@ -104,7 +106,7 @@ enable_svm()
 }
 
 
-#ifndef NDEBUG
+#if !defined(NDEBUG) && defined(CONFIG_SERIAL)
 static unsigned int serial_initialized;
 #define SERIAL_BASE 0x3f8
 
@@ -150,6 +152,7 @@ serial_send(unsigned value)
 int
 out_char(unsigned value)
 {
+#ifdef CONFIG_VGA
 #define BASE(ROW) ((unsigned short *) (0xb8000+ROW*160))
   static unsigned int col;
   if (value!='\n')
@@ -158,10 +161,6 @@ out_char(unsigned value)
       *p = 0x0f00 | value;
       col++;
     }
-#ifndef NDEBUG
-  else
-    serial_send('\r');
-#endif
 
   if (col>=80 || value == '\n')
     {
@@ -170,8 +169,11 @@ out_char(unsigned value)
       memcpy(p, p+80, 24*160);
       memset(BASE(24), 0, 160);
     }
+#endif
 
-#ifndef NDEBUG
+#if !defined(NDEBUG) && defined(CONFIG_SERIAL)
+  if (value == '\n')
+    serial_send('\r');
   serial_send(value);
 #endif
 